@@ -90,6 +90,7 @@ static RESTYPE RTAlarmClient;
 static RESTYPE RTFence;
 static struct xorg_list SysCounterList;
 static int SyncNumInvalidCounterWarnings = 0;
+static unsigned long SyncTriggerSerial = 0;
 
 #define MAX_INVALID_COUNTER_WARNINGS	   5
 
@@ -137,6 +138,153 @@ SyncCheckWarnIsCounter(const SyncObject * pSync, const char *warning)
     return TRUE;
 }
 
+/*  Counters also keep their triggers in one array per test type, sorted
+ *  by test value, so that a counter change only has to look at the
+ *  triggers whose threshold it crossed and the bracket values of a system
+ *  counter come from a binary search.  The trigger list stays the
+ *  authority on which triggers exist and on the order they fire in.
+ *
+ *  Every array has room for all of the counter's triggers, so moving a
+ *  trigger between arrays never allocates; the spare block at the end
+ *  holds the triggers SyncChangeCounter is about to run.
+ */
+#define SYNC_NUM_TEST_TYPES 4
+
+typedef struct _SyncTriggerIndex {
+    SyncTriggerList **byTest[SYNC_NUM_TEST_TYPES];
+    SyncTriggerList **crossed;
+    int num[SYNC_NUM_TEST_TYPES];
+    int count;                  /* triggers on the counter */
+    int size;                   /* room in each array */
+    int dispatching;            /* SyncChangeCounter is running triggers */
+    SyncTriggerList *pDeleted;  /* freed once it is done */
+} SyncTriggerIndex;
+
+/* first position whose test value is >= value, or > value if after */
+static int
+SyncIndexSearch(SyncTriggerList **nodes, int num, int64_t value, Bool after)
+{
+    int lo = 0, hi = num;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (nodes[mid]->test_value < value ||
+            (after && nodes[mid]->test_value == value))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void
+SyncIndexInsert(SyncTriggerIndex *idx, SyncTriggerList *ptl)
+{
+    SyncTriggerList **nodes;
+    int num, pos;
+
+    ptl->test_type = ptl->pTrigger->test_type;
+    ptl->test_value = ptl->pTrigger->test_value;
+    if (ptl->test_type >= SYNC_NUM_TEST_TYPES)
+        return;
+
+    nodes = idx->byTest[ptl->test_type];
+    num = idx->num[ptl->test_type]++;
+    pos = SyncIndexSearch(nodes, num, ptl->test_value, TRUE);
+    memmove(&nodes[pos + 1], &nodes[pos], (num - pos) * sizeof(*nodes));
+    nodes[pos] = ptl;
+}
+
+static void
+SyncIndexRemove(SyncTriggerIndex *idx, SyncTriggerList *ptl)
+{
+    SyncTriggerList **nodes;
+    int num, pos;
+
+    if (ptl->test_type >= SYNC_NUM_TEST_TYPES)
+        return;
+
+    nodes = idx->byTest[ptl->test_type];
+    num = idx->num[ptl->test_type];
+    pos = SyncIndexSearch(nodes, num, ptl->test_value, FALSE);
+    while (pos < num && nodes[pos] != ptl)
+        pos++;
+    if (pos == num)
+        return;
+
+    memmove(&nodes[pos], &nodes[pos + 1], (num - pos - 1) * sizeof(*nodes));
+    idx->num[ptl->test_type]--;
+}
+
+/* re-sort a trigger whose test type or value may have changed */
+static void
+SyncIndexUpdate(SyncTriggerIndex *idx, SyncTriggerList *ptl)
+{
+    if (ptl->test_type == ptl->pTrigger->test_type &&
+        ptl->test_value == ptl->pTrigger->test_value)
+        return;
+
+    SyncIndexRemove(idx, ptl);
+    SyncIndexInsert(idx, ptl);
+}
+
+static Bool
+SyncIndexReserve(SyncCounter *pCounter)
+{
+    SyncTriggerIndex *idx = pCounter->pTrigIndex;
+    SyncTriggerList **nodes, **old;
+    int size, t;
+
+    if (!idx) {
+        if (!(idx = calloc(1, sizeof(SyncTriggerIndex))))
+            return FALSE;
+        pCounter->pTrigIndex = idx;
+    }
+    if (idx->count < idx->size)
+        return TRUE;
+    /* SyncChangeCounter is still walking the old arrays */
+    BUG_RETURN_VAL(idx->dispatching, FALSE);
+
+    size = idx->size ? idx->size * 2 : 4;
+    nodes = xallocarray(size * (SYNC_NUM_TEST_TYPES + 1), sizeof(*nodes));
+    if (!nodes)
+        return FALSE;
+
+    old = idx->byTest[0];
+    for (t = 0; t < SYNC_NUM_TEST_TYPES; t++) {
+        if (idx->num[t])
+            memcpy(nodes + t * size, idx->byTest[t],
+                   idx->num[t] * sizeof(*nodes));
+        idx->byTest[t] = nodes + t * size;
+    }
+    idx->crossed = nodes + SYNC_NUM_TEST_TYPES * size;
+    free(old);
+    idx->size = size;
+    return TRUE;
+}
+
+/*  Call after changing the test type or value of a trigger outside of
+ *  SyncChangeCounter, which takes care of the ones it fires itself.
+ */
+static void
+SyncTriggerMoved(SyncTrigger * pTrigger)
+{
+    SyncTriggerList *ptl;
+    SyncCounter *pCounter;
+
+    if (!pTrigger->pSync || SYNC_COUNTER != pTrigger->pSync->type)
+        return;
+
+    pCounter = (SyncCounter *) pTrigger->pSync;
+    for (ptl = pCounter->sync.pTriglist; ptl; ptl = ptl->next) {
+        if (ptl->pTrigger == pTrigger) {
+            SyncIndexUpdate(pCounter->pTrigIndex, ptl);
+            break;
+        }
+    }
+}
+
 /*  Each counter maintains a simple linked list of triggers that are
  *  interested in the counter.  The two functions below are used to
  *  delete and add triggers on this list.
@@ -158,12 +306,28 @@ SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
 
     while (pCur) {
         if (pCur->pTrigger == pTrigger) {
+            SyncTriggerIndex *idx = NULL;
+
             if (pPrev)
                 pPrev->next = pCur->next;
             else
                 pTrigger->pSync->pTriglist = pCur->next;
 
-            free(pCur);
+            if (SYNC_COUNTER == pTrigger->pSync->type)
+                idx = ((SyncCounter *) pTrigger->pSync)->pTrigIndex;
+
+            if (idx) {
+                SyncIndexRemove(idx, pCur);
+                idx->count--;
+            }
+            if (idx && idx->dispatching) {
+                /* SyncChangeCounter may still hold on to it */
+                pCur->pTrigger = NULL;
+                pCur->next = idx->pDeleted;
+                idx->pDeleted = pCur;
+            }
+            else
+                free(pCur);
             break;
         }
 
@@ -199,16 +363,24 @@ SyncAddTriggerToSyncObject(SyncTrigger * pTrigger)
             return Success;
     }
 
+    if (SYNC_COUNTER == pTrigger->pSync->type &&
+        !SyncIndexReserve((SyncCounter *) pTrigger->pSync))
+        return BadAlloc;
+
     if (!(pCur = malloc(sizeof(SyncTriggerList))))
         return BadAlloc;
 
     pCur->pTrigger = pTrigger;
     pCur->next = pTrigger->pSync->pTriglist;
+    pCur->serial = ++SyncTriggerSerial;
     pTrigger->pSync->pTriglist = pCur;
 
     if (SYNC_COUNTER == pTrigger->pSync->type) {
         pCounter = (SyncCounter *) pTrigger->pSync;
 
+        SyncIndexInsert(pCounter->pTrigIndex, pCur);
+        pCounter->pTrigIndex->count++;
+
         if (IsSystemCounter(pCounter))
             SyncComputeBracketValues(pCounter);
     }
@@ -396,6 +568,7 @@ SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
                                          pCounter->value, pTrigger->wait_value);
             if (overflow) {
                 client->errorValue = pTrigger->wait_value >> 32;
+                SyncTriggerMoved(pTrigger);
                 return BadValue;
             }
         }
@@ -408,8 +581,10 @@ SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
         if ((rc = SyncAddTriggerToSyncObject(pTrigger)) != Success)
             return rc;
     }
-    else if (pCounter && IsSystemCounter(pCounter)) {
-        SyncComputeBracketValues(pCounter);
+    else {
+        SyncTriggerMoved(pTrigger);
+        if (pCounter && IsSystemCounter(pCounter))
+            SyncComputeBracketValues(pCounter);
     }
 
     return Success;
@@ -707,19 +882,122 @@ SyncUpdateCounter(SyncCounter *pCounter, int64_t newval)
 /*  This function should always be used to change a counter's value so that
  *  any triggers depending on the counter will be checked.
  */
+static int
+SyncCompareSerial(const void *a, const void *b)
+{
+    unsigned long sa = (*(SyncTriggerList * const *) a)->serial;
+    unsigned long sb = (*(SyncTriggerList * const *) b)->serial;
+
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/*  Find the triggers of one test type that a change from oldval to newval
+ *  can make true, as the range [*first, *last) of idx->byTest[type].
+ */
+static void
+SyncIndexCrossed(SyncTriggerIndex *idx, int type, int64_t oldval,
+                 int64_t newval, int *first, int *last)
+{
+    SyncTriggerList **nodes = idx->byTest[type];
+    int num = idx->num[type];
+
+    *first = *last = 0;
+    switch (type) {
+    case XSyncPositiveComparison:      /* test_value <= newval */
+        *last = SyncIndexSearch(nodes, num, newval, TRUE);
+        break;
+    case XSyncNegativeComparison:      /* test_value >= newval */
+        *first = SyncIndexSearch(nodes, num, newval, FALSE);
+        *last = num;
+        break;
+    case XSyncPositiveTransition:      /* oldval < test_value <= newval */
+        if (oldval < newval) {
+            *first = SyncIndexSearch(nodes, num, oldval, TRUE);
+            *last = SyncIndexSearch(nodes, num, newval, TRUE);
+        }
+        break;
+    case XSyncNegativeTransition:      /* newval <= test_value < oldval */
+        if (newval < oldval) {
+            *first = SyncIndexSearch(nodes, num, newval, FALSE);
+            *last = SyncIndexSearch(nodes, num, oldval, FALSE);
+        }
+        break;
+    }
+}
+
 void
 SyncChangeCounter(SyncCounter * pCounter, int64_t newval)
 {
-    SyncTriggerList *ptl, *pnext;
+    SyncTriggerIndex *idx = pCounter->pTrigIndex;
+    SyncTriggerList *ptl, **crossed;
     int64_t oldval;
+    int first[SYNC_NUM_TEST_TYPES], last[SYNC_NUM_TEST_TYPES];
+    int num = 0, i, t;
 
     oldval = SyncUpdateCounter(pCounter, newval);
 
-    /* run through triggers to see if any become true */
-    for (ptl = pCounter->sync.pTriglist; ptl; ptl = pnext) {
-        pnext = ptl->next;
-        if ((*ptl->pTrigger->CheckTrigger) (ptl->pTrigger, oldval))
-            (*ptl->pTrigger->TriggerFired) (ptl->pTrigger);
+    if (idx) {
+        for (t = 0; t < SYNC_NUM_TEST_TYPES; t++) {
+            SyncIndexCrossed(idx, t, oldval, newval, &first[t], &last[t]);
+            num += last[t] - first[t];
+        }
+    }
+
+    if (num) {
+        /* the triggers may add or delete triggers, so work on a copy */
+        if (idx->dispatching)
+            crossed = xallocarray(num, sizeof(*crossed));
+        else
+            crossed = idx->crossed;
+
+        /*  Run them in list order, like a walk over pTriglist would.
+         *  When a good part of the list fires anyway, picking them out of
+         *  the list is cheaper than sorting; test values equal to a range
+         *  end are always in the range, so comparing values is enough.
+         */
+        if (!crossed)
+            num = 0;
+        else if (num > idx->count / 16) {
+            num = 0;
+            for (ptl = pCounter->sync.pTriglist; ptl; ptl = ptl->next) {
+                t = ptl->test_type;
+                if (t < SYNC_NUM_TEST_TYPES && first[t] < last[t] &&
+                    ptl->test_value >= idx->byTest[t][first[t]]->test_value &&
+                    ptl->test_value <= idx->byTest[t][last[t] - 1]->test_value)
+                    crossed[num++] = ptl;
+            }
+        }
+        else {
+            num = 0;
+            for (t = 0; t < SYNC_NUM_TEST_TYPES; t++) {
+                memcpy(&crossed[num], &idx->byTest[t][first[t]],
+                       (last[t] - first[t]) * sizeof(*crossed));
+                num += last[t] - first[t];
+            }
+            if (num > 1)
+                qsort(crossed, num, sizeof(*crossed), SyncCompareSerial);
+        }
+
+        idx->dispatching++;
+        for (i = 0; i < num; i++) {
+            ptl = crossed[i];
+            if (!ptl->pTrigger)
+                continue;       /* deleted by an earlier trigger */
+            if ((*ptl->pTrigger->CheckTrigger) (ptl->pTrigger, oldval)) {
+                (*ptl->pTrigger->TriggerFired) (ptl->pTrigger);
+                /* alarms move on to their next test value */
+                if (ptl->pTrigger)
+                    SyncIndexUpdate(idx, ptl);
+            }
+        }
+        if (--idx->dispatching == 0) {
+            while ((ptl = idx->pDeleted)) {
+                idx->pDeleted = ptl->next;
+                free(ptl);
+            }
+        }
+        if (crossed != idx->crossed)
+            free(crossed);
     }
 
     if (IsSystemCounter(pCounter)) {
@@ -956,6 +1234,7 @@ SyncCreateCounter(ClientPtr client, XSyncCounter id, int64_t initialvalue)
 
     pCounter->value = initialvalue;
     pCounter->pSysCounterInfo = NULL;
+    pCounter->pTrigIndex = NULL;
 
     if (!AddResource(id, RTCounter, (void *) pCounter))
         return NULL;
@@ -1011,11 +1290,33 @@ SyncDestroySystemCounter(void *pSysCounter)
     FreeResource(pCounter->sync.id, RT_NONE);
 }
 
+/*  Narrow the bracket values to the nearest test values of one test type
+ *  above and below the counter value.  An inclusive bound also counts a
+ *  test value equal to the counter value, for the transitions that need
+ *  one more change in that direction to fire.
+ */
+static void
+SyncBracketTestType(SyncTriggerIndex *idx, int type, int64_t value,
+                    Bool greaterInclusive, Bool lessInclusive,
+                    SysCounterInfo *psci)
+{
+    SyncTriggerList **nodes = idx->byTest[type];
+    int num = idx->num[type];
+    int pos;
+
+    pos = SyncIndexSearch(nodes, num, value, !greaterInclusive);
+    if (pos < num && nodes[pos]->test_value < psci->bracket_greater)
+        psci->bracket_greater = nodes[pos]->test_value;
+
+    pos = SyncIndexSearch(nodes, num, value, lessInclusive);
+    if (pos > 0 && nodes[pos - 1]->test_value > psci->bracket_less)
+        psci->bracket_less = nodes[pos - 1]->test_value;
+}
+
 static void
 SyncComputeBracketValues(SyncCounter * pCounter)
 {
-    SyncTriggerList *pCur;
-    SyncTrigger *pTrigger;
+    SyncTriggerIndex *idx;
     SysCounterInfo *psci;
     int64_t *pnewgtval = NULL;
     int64_t *pnewltval = NULL;
@@ -1032,73 +1333,31 @@ SyncComputeBracketValues(SyncCounter * pCounter)
     psci->bracket_greater = LLONG_MAX;
     psci->bracket_less = LLONG_MIN;
 
-    for (pCur = pCounter->sync.pTriglist; pCur; pCur = pCur->next) {
-        pTrigger = pCur->pTrigger;
-
-        if (pTrigger->test_type == XSyncPositiveComparison &&
-            ct != XSyncCounterNeverIncreases) {
-            if (pCounter->value < pTrigger->test_value &&
-                pTrigger->test_value < psci->bracket_greater) {
-                psci->bracket_greater = pTrigger->test_value;
-                pnewgtval = &psci->bracket_greater;
-            }
-            else if (pCounter->value > pTrigger->test_value &&
-                     pTrigger->test_value > psci->bracket_less) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-        }
-        else if (pTrigger->test_type == XSyncNegativeComparison &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (pCounter->value > pTrigger->test_value &&
-                pTrigger->test_value > psci->bracket_less) {
-                psci->bracket_less = pTrigger->test_value;
-                pnewltval = &psci->bracket_less;
-            }
-            else if (pCounter->value < pTrigger->test_value &&
-                     pTrigger->test_value < psci->bracket_greater) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-        }
-        else if (pTrigger->test_type == XSyncNegativeTransition &&
-                 ct != XSyncCounterNeverIncreases) {
-            if (pCounter->value >= pTrigger->test_value &&
-                pTrigger->test_value > psci->bracket_less) {
-                    /*
-                     * If the value is exactly equal to our threshold, we want one
-                     * more event in the negative direction to ensure we pick up
-                     * when the value is less than this threshold.
-                     */
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-            else if (pCounter->value < pTrigger->test_value &&
-                     pTrigger->test_value < psci->bracket_greater) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
+    if ((idx = pCounter->pTrigIndex)) {
+        if (ct != XSyncCounterNeverIncreases) {
+            SyncBracketTestType(idx, XSyncPositiveComparison, pCounter->value,
+                                FALSE, FALSE, psci);
+            /*
+             * If the value is exactly equal to a NegativeTransition
+             * threshold, we want one more event in the negative direction
+             * to ensure we pick up when the value is less than it.
+             */
+            SyncBracketTestType(idx, XSyncNegativeTransition, pCounter->value,
+                                FALSE, TRUE, psci);
         }
-        else if (pTrigger->test_type == XSyncPositiveTransition &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (pCounter->value <= pTrigger->test_value &&
-                pTrigger->test_value < psci->bracket_greater) {
-                    /*
-                     * If the value is exactly equal to our threshold, we
-                     * want one more event in the positive direction to
-                     * ensure we pick up when the value *exceeds* this
-                     * threshold.
-                     */
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-            else if (pCounter->value > pTrigger->test_value &&
-                     pTrigger->test_value > psci->bracket_less) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
+        if (ct != XSyncCounterNeverDecreases) {
+            SyncBracketTestType(idx, XSyncNegativeComparison, pCounter->value,
+                                FALSE, FALSE, psci);
+            /* and the same for PositiveTransition in the other direction */
+            SyncBracketTestType(idx, XSyncPositiveTransition, pCounter->value,
+                                TRUE, FALSE, psci);
         }
-    }                           /* end for each trigger */
+    }
+
+    if (psci->bracket_greater < LLONG_MAX)
+        pnewgtval = &psci->bracket_greater;
+    if (psci->bracket_less > LLONG_MIN)
+        pnewltval = &psci->bracket_less;
 
     (*psci->BracketValues) ((void *) pCounter, pnewltval, pnewgtval);
 
@@ -1146,6 +1405,10 @@ FreeCounter(void *env, XID id)
         pnext = ptl->next;
         free(ptl);              /* destroy the trigger list as we go */
     }
+    if (pCounter->pTrigIndex) {
+        free(pCounter->pTrigIndex->byTest[0]);
+        free(pCounter->pTrigIndex);
+    }
     if (IsSystemCounter(pCounter)) {
         xorg_list_del(&pCounter->pSysCounterInfo->entry);
         free(pCounter->pSysCounterInfo->name);
@@ -1739,8 +2002,10 @@ ProcSyncCreateAlarm(ClientPtr client)
 
         pCounter = (SyncCounter *) pTrigger->pSync;
 
-        if ((*pTrigger->CheckTrigger) (pTrigger, pCounter->value))
+        if ((*pTrigger->CheckTrigger) (pTrigger, pCounter->value)) {
             (*pTrigger->TriggerFired) (pTrigger);
+            SyncTriggerMoved(pTrigger);
+        }
     }
 
     return Success;
@@ -1786,6 +2051,7 @@ ProcSyncChangeAlarm(ClientPtr client)
     if (!pCounter ||
         (*pAlarm->trigger.CheckTrigger) (&pAlarm->trigger, pCounter->value)) {
         (*pAlarm->trigger.TriggerFired) (&pAlarm->trigger);
+        SyncTriggerMoved(&pAlarm->trigger);
     }
     return Success;
 }
@@ -46,6 +46,7 @@
 #endif
 
 #include "compint.h"
+#include "mivalidate.h"
 
 static void
 compScreenUpdate(ScreenPtr pScreen)
@@ -115,6 +116,12 @@ compMarkWindows(WindowPtr pWin, WindowPtr *ppLayerWin)
         return FALSE;
 
     (*pScreen->MarkOverlappedWindows) (pWin, pWin, &pLayerWin);
+    /*
+     * Redirection changes the universe the subtree is clipped against,
+     * even when the borderClip of pWin stays the same.
+     */
+    if (pWin->valdata)
+        pWin->valdata->before.resized = TRUE;
     (*pScreen->MarkWindow) (pLayerWin->parent);
 
     *ppLayerWin = pLayerWin;
@@ -188,6 +195,8 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
             free(cw);
             return BadAlloc;
         }
+        /* automatic updates composite the damage box by box */
+        DamageSetRectLimit(cw->damage, COMP_DAMAGE_RECTS, 0);
 
         anyMarked = compMarkWindows(pWin, &pLayerWin);
 
@@ -101,6 +101,9 @@ typedef struct _CompWindow {
 
 #define COMP_ORIGIN_INVALID	    0x80000000
 
+/* box limit for the damage of automatically redirected windows */
+#define COMP_DAMAGE_RECTS	    32
+
 typedef struct _CompSubwindows {
     int update;
     CompClientWindowPtr clients;
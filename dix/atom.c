@@ -57,84 +57,163 @@ SOFTWARE.
 #include "dix.h"
 
 #define InitialTableSize 256
+#define InitialHashSize 512
+#define AtomArenaChunkSize 65536
 
-typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
-    unsigned int fingerPrint;
+/*
+ * Atom names are kept in a table indexed by atom, and looked up by name
+ * through an open-addressed hash table.  Each hash slot holds the full
+ * hash value next to the atom, so a probe sequence only touches the name
+ * itself once the hashes match.  Names of atoms created at runtime are
+ * copied into large arena chunks instead of being allocated one by one.
+ */
+
+typedef struct _AtomName {
     const char *string;
-} NodeRec, *NodePtr;
+    unsigned int len;
+    unsigned int hash;
+} AtomNameRec, *AtomNamePtr;
+
+typedef struct _AtomSlot {
+    unsigned int hash;
+    Atom a;
+} AtomSlotRec, *AtomSlotPtr;
+
+typedef struct _AtomChunk {
+    struct _AtomChunk *next;
+    size_t used;
+    size_t size;
+    char *data;
+} AtomChunkRec, *AtomChunkPtr;
 
 static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
 static unsigned long tableLength;
-static NodePtr *nodeTable;
+static AtomNamePtr nodeTable;
+static unsigned long hashMask;
+static AtomSlotPtr hashTable;
+static AtomChunkPtr atomChunks;
 
-Atom
-MakeAtom(const char *string, unsigned len, Bool makeit)
+static unsigned int
+AtomHash(const char *string, unsigned len)
 {
-    NodePtr *np;
+    unsigned int hash = 2166136261u;
     unsigned i;
-    int comp;
-    unsigned int fp = 0;
 
-    np = &atomRoot;
-    for (i = 0; i < (len + 1) / 2; i++) {
-        fp = fp * 27 + string[i];
-        fp = fp * 27 + string[len - 1 - i];
+    /* FNV-1a */
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char) string[i];
+        hash *= 16777619u;
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
-    }
-    if (makeit) {
-        NodePtr nd;
+    return hash;
+}
 
-        nd = malloc(sizeof(NodeRec));
-        if (!nd)
-            return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
+static const char *
+AtomArenaCopy(const char *string, unsigned len)
+{
+    AtomChunkPtr chunk = atomChunks;
+    char *copy;
+
+    if (!chunk || chunk->size - chunk->used < len + 1) {
+        size_t size = AtomArenaChunkSize;
+
+        if (len + 1 > size)
+            size = len + 1;
+        chunk = malloc(sizeof(AtomChunkRec) + size);
+        if (!chunk)
+            return NULL;
+        chunk->data = (char *) (chunk + 1);
+        chunk->used = 0;
+        chunk->size = size;
+        /* an oversized chunk is full already, keep filling the current one */
+        if (atomChunks && size > AtomArenaChunkSize) {
+            chunk->next = atomChunks->next;
+            atomChunks->next = chunk;
         }
         else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
+            chunk->next = atomChunks;
+            atomChunks = chunk;
         }
+    }
+    copy = chunk->data + chunk->used;
+    memcpy(copy, string, len);
+    copy[len] = '\0';
+    chunk->used += len + 1;
+    return copy;
+}
+
+static Bool
+GrowHashTable(void)
+{
+    unsigned long size = (hashMask + 1) * 2;
+    AtomSlotPtr table;
+    Atom a;
+
+    table = calloc(size, sizeof(AtomSlotRec));
+    if (!table)
+        return FALSE;
+    for (a = 1; a <= lastAtom; a++) {
+        unsigned long i = nodeTable[a].hash & (size - 1);
+
+        while (table[i].a != None)
+            i = (i + 1) & (size - 1);
+        table[i].hash = nodeTable[a].hash;
+        table[i].a = a;
+    }
+    free(hashTable);
+    hashTable = table;
+    hashMask = size - 1;
+    return TRUE;
+}
+
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    unsigned int hash = AtomHash(string, len);
+    unsigned long i;
+    AtomNamePtr nd;
+
+    for (i = hash & hashMask; hashTable[i].a != None; i = (i + 1) & hashMask) {
+        if (hashTable[i].hash == hash) {
+            nd = &nodeTable[hashTable[i].a];
+            if (nd->len == len && memcmp(nd->string, string, len) == 0)
+                return hashTable[i].a;
+        }
+    }
+    if (makeit) {
+        const char *name;
+
         if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodePtr));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
+            AtomNamePtr table;
+
+            table = reallocarray(nodeTable, tableLength, 2 * sizeof(AtomNameRec));
+            if (!table)
                 return BAD_RESOURCE;
-            }
             tableLength <<= 1;
             nodeTable = table;
         }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
+        /* keep the load factor at or below one half */
+        if ((lastAtom + 1) * 2 > hashMask + 1) {
+            if (!GrowHashTable())
+                return BAD_RESOURCE;
+            for (i = hash & hashMask; hashTable[i].a != None;
+                 i = (i + 1) & hashMask)
+                ;
+        }
+        if (lastAtom < XA_LAST_PREDEFINED) {
+            name = string;
+        }
+        else {
+            name = AtomArenaCopy(string, len);
+            if (!name)
+                return BAD_RESOURCE;
+        }
+        nd = &nodeTable[++lastAtom];
+        nd->string = name;
+        nd->len = len;
+        nd->hash = hash;
+        hashTable[i].hash = hash;
+        hashTable[i].a = lastAtom;
+        return lastAtom;
     }
     else
         return None;
@@ -149,13 +228,9 @@ ValidAtom(Atom atom)
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > lastAtom)
         return 0;
-    return node->string;
+    return nodeTable[atom].string;
 }
 
 void
@@ -164,30 +239,18 @@ AtomError(void)
     FatalError("initializing atoms");
 }
 
-static void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
-}
-
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
-        return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
+    while (atomChunks) {
+        AtomChunkPtr next = atomChunks->next;
+
+        free(atomChunks);
+        atomChunks = next;
+    }
+    free(hashTable);
+    hashTable = NULL;
+    hashMask = 0;
     free(nodeTable);
     nodeTable = NULL;
     lastAtom = None;
@@ -198,10 +261,16 @@ InitAtoms(void)
 {
     FreeAllAtoms();
     tableLength = InitialTableSize;
-    nodeTable = xallocarray(InitialTableSize, sizeof(NodePtr));
+    nodeTable = xallocarray(InitialTableSize, sizeof(AtomNameRec));
     if (!nodeTable)
         AtomError();
-    nodeTable[None] = NULL;
+    nodeTable[None].string = NULL;
+    nodeTable[None].len = 0;
+    nodeTable[None].hash = 0;
+    hashTable = calloc(InitialHashSize, sizeof(AtomSlotRec));
+    if (!hashTable)
+        AtomError();
+    hashMask = InitialHashSize - 1;
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         AtomError();
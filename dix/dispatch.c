@@ -129,6 +129,7 @@ int ProcInitialConnection();
 #include "xkbsrv.h"
 #include "site.h"
 #include "client.h"
+#include "reqprof.h"
 
 #ifdef XSERVER_DTRACE
 #include "registry.h"
@@ -405,6 +406,7 @@ Dispatch(void)
     int result;
     ClientPtr client;
     long start_tick;
+    CARD64 request_start;
 
     nextFreeClientID = 1;
     nClients = 0;
@@ -412,7 +414,15 @@ Dispatch(void)
     SmartScheduleSlice = SmartScheduleInterval;
     init_client_ready();
 
+    if (RequestProfiling)
+        RequestProfileInit();
+
     while (!dispatchException) {
+        if (RequestProfileDumpPending) {
+            RequestProfileDump();
+            CallCallbacks(&RequestProfileDumpCallback, NULL);
+        }
+
         if (InputCheckPending()) {
             ProcessInputEvents();
             FlushIfCriticalOutputPending();
@@ -470,6 +480,11 @@ Dispatch(void)
                                           client->index,
                                           client->requestBuffer);
 #endif
+                /* leave the connection setup out of the profile */
+                request_start = 0;
+                if (RequestProfiling && client->requestVector != InitialVector)
+                    request_start = GetTimeInMicros();
+
                 if (result > (maxBigRequestSize << 2))
                     result = BadLength;
                 else {
@@ -480,6 +495,8 @@ Dispatch(void)
                 }
                 if (!SmartScheduleSignalEnable)
                     SmartScheduleTime = GetTimeInMillis();
+                if (request_start)
+                    RequestProfileRecord(client, request_start);
 
 #ifdef XSERVER_DTRACE
                 if (XSERVER_REQUEST_DONE_ENABLED())
@@ -508,6 +525,10 @@ Dispatch(void)
 #if defined(DDXBEFORERESET)
     ddxBeforeReset();
 #endif
+    if (RequestProfiling) {
+        RequestProfileDump();
+        RequestProfileReset();
+    }
     KillAllClients();
     dispatchException &= ~DE_RESET;
     SmartScheduleLatencyLimited = 0;
@@ -124,6 +124,9 @@ AllocatePixmap(ScreenPtr pScreen, int pixDataSize)
     return pPixmap;
 }
 
+unsigned long PixmapPoolLimit = 8 << 20;
+Bool PixmapPoolHugePages = FALSE;
+
 /* callable by ddx */
 void
 FreePixmap(PixmapPtr pPixmap)
@@ -86,6 +86,219 @@ PrintPropertys(WindowPtr pWin)
 }
 #endif
 
+/*
+ * Windows with many properties get a hash index mapping each property
+ * name to the first property of that name in the window's list, so that
+ * lookups don't have to walk the list.  The list itself stays the
+ * authoritative store and keeps its order for ListProperties.  The index
+ * is only an accelerator: if it can't be allocated or grown it is simply
+ * dropped and lookups fall back to walking the list.
+ */
+
+#define PROPERTY_INDEX_THRESHOLD 16
+#define PROPERTY_INDEX_MIN_SIZE 64
+
+typedef struct _PropertyIndexEntry {
+    ATOM name;
+    PropertyPtr prop;
+} PropertyIndexEntry;
+
+typedef struct _PropertyIndex {
+    unsigned int mask;
+    unsigned int count;
+    PropertyIndexEntry *entries;
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline unsigned int
+PropertyIndexHash(ATOM name)
+{
+    unsigned int h = name * 2654435761u;
+
+    return h ^ (h >> 16);
+}
+
+static PropertyPtr
+PropertyIndexFind(PropertyIndexPtr index, ATOM name)
+{
+    unsigned int i;
+
+    for (i = PropertyIndexHash(name) & index->mask; index->entries[i].prop;
+         i = (i + 1) & index->mask)
+        if (index->entries[i].name == name)
+            return index->entries[i].prop;
+    return NULL;
+}
+
+static Bool
+PropertyIndexResize(PropertyIndexPtr index, unsigned int size)
+{
+    PropertyIndexEntry *entries, *old = index->entries;
+    unsigned int i, j, oldsize = old ? index->mask + 1 : 0;
+
+    entries = calloc(size, sizeof(PropertyIndexEntry));
+    if (!entries)
+        return FALSE;
+    for (i = 0; i < oldsize; i++) {
+        if (!old[i].prop)
+            continue;
+        for (j = PropertyIndexHash(old[i].name) & (size - 1); entries[j].prop;
+             j = (j + 1) & (size - 1))
+            ;
+        entries[j] = old[i];
+    }
+    free(old);
+    index->entries = entries;
+    index->mask = size - 1;
+    return TRUE;
+}
+
+static Bool
+PropertyIndexSet(PropertyIndexPtr index, ATOM name, PropertyPtr prop)
+{
+    unsigned int i;
+
+    for (i = PropertyIndexHash(name) & index->mask; index->entries[i].prop;
+         i = (i + 1) & index->mask)
+        if (index->entries[i].name == name)
+            break;
+
+    if (!index->entries[i].prop) {
+        /* keep the table at most half full */
+        if ((index->count + 1) * 2 > index->mask + 1) {
+            if (!PropertyIndexResize(index, (index->mask + 1) * 2))
+                return FALSE;
+            for (i = PropertyIndexHash(name) & index->mask;
+                 index->entries[i].prop; i = (i + 1) & index->mask)
+                ;
+        }
+        index->count++;
+    }
+    index->entries[i].name = name;
+    index->entries[i].prop = prop;
+    return TRUE;
+}
+
+static void
+PropertyIndexRemove(PropertyIndexPtr index, ATOM name)
+{
+    unsigned int i, j, home;
+
+    for (i = PropertyIndexHash(name) & index->mask; index->entries[i].prop;
+         i = (i + 1) & index->mask)
+        if (index->entries[i].name == name)
+            break;
+    if (!index->entries[i].prop)
+        return;
+
+    /* shift back the rest of the probe sequence into the hole */
+    for (j = (i + 1) & index->mask; index->entries[j].prop;
+         j = (j + 1) & index->mask) {
+        home = PropertyIndexHash(index->entries[j].name) & index->mask;
+        if (((j - home) & index->mask) >= ((j - i) & index->mask)) {
+            index->entries[i] = index->entries[j];
+            i = j;
+        }
+    }
+    index->entries[i].prop = NULL;
+    index->count--;
+}
+
+static void
+DestroyPropertyIndex(WindowPtr pWin)
+{
+    PropertyIndexPtr index = pWin->optional->userPropIndex;
+
+    if (index) {
+        free(index->entries);
+        free(index);
+        pWin->optional->userPropIndex = NULL;
+    }
+}
+
+static void
+BuildPropertyIndex(WindowPtr pWin)
+{
+    PropertyIndexPtr index;
+    PropertyPtr pProp;
+
+    index = calloc(1, sizeof(PropertyIndexRec));
+    if (!index)
+        return;
+    pWin->optional->userPropIndex = index;
+    if (!PropertyIndexResize(index, PROPERTY_INDEX_MIN_SIZE)) {
+        DestroyPropertyIndex(pWin);
+        return;
+    }
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next) {
+        if (PropertyIndexFind(index, pProp->propertyName))
+            continue;
+        if (!PropertyIndexSet(index, pProp->propertyName, pProp)) {
+            DestroyPropertyIndex(pWin);
+            return;
+        }
+    }
+}
+
+/* Add a new property to the head of the window's property list */
+static void
+LinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->userPropIndex;
+
+    pProp->next = pWin->optional->userProps;
+    pWin->optional->userProps = pProp;
+
+    if (index) {
+        if (!PropertyIndexSet(index, pProp->propertyName, pProp))
+            DestroyPropertyIndex(pWin);
+    }
+    else {
+        int n = 0;
+
+        for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next)
+            if (++n >= PROPERTY_INDEX_THRESHOLD) {
+                BuildPropertyIndex(pWin);
+                break;
+            }
+    }
+}
+
+static void
+UnlinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->userPropIndex;
+    PropertyPtr prevProp;
+
+    if (pWin->optional->userProps == pProp) {
+        /* Takes care of head */
+        pWin->optional->userProps = pProp->next;
+    }
+    else {
+        /* Need to traverse to find the previous element */
+        prevProp = pWin->optional->userProps;
+        while (prevProp->next != pProp)
+            prevProp = prevProp->next;
+        prevProp->next = pProp->next;
+    }
+
+    if (!pWin->optional->userProps) {
+        DestroyPropertyIndex(pWin);
+        CheckWindowOptionalNeed(pWin);
+    }
+    else if (index && PropertyIndexFind(index, pProp->propertyName) == pProp) {
+        PropertyPtr other;
+
+        /* a security module may keep several properties of one name */
+        for (other = pProp->next; other; other = other->next)
+            if (other->propertyName == pProp->propertyName)
+                break;
+        if (other)
+            PropertyIndexSet(index, other->propertyName, other);
+        else
+            PropertyIndexRemove(index, pProp->propertyName);
+    }
+}
+
 int
 dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
                   ClientPtr client, Mask access_mode)
@@ -95,9 +308,13 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    if (pWin->optional && pWin->optional->userPropIndex)
+        pProp = PropertyIndexFind(pWin->optional->userPropIndex,
+                                  propertyName);
+    else
+        for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
+            if (pProp->propertyName == propertyName)
+                break;
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -293,8 +510,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
             pClient->errorValue = property;
             return rc;
         }
-        pProp->next = pWin->optional->userProps;
-        pWin->optional->userProps = pProp;
+        LinkProperty(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -368,7 +584,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -376,18 +592,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
         free(pProp->data);
@@ -410,8 +615,10 @@ DeleteAllWindowProperties(WindowPtr pWin)
         pProp = pNextProp;
     }
 
-    if (pWin->optional)
+    if (pWin->optional) {
         pWin->optional->userProps = NULL;
+        DestroyPropertyIndex(pWin);
+    }
 }
 
 static int
@@ -443,7 +650,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -546,18 +753,7 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -84,6 +84,8 @@ Equipment Corporation.
 #include <X11/Xfuncproto.h>
 #include "gc.h"
 #include <pixman.h>
+#include <stdint.h>
+#include <string.h>
 
 #undef assert
 #ifdef REGION_DEBUG
@@ -214,6 +216,15 @@ if (((numRects) < ((reg)->data->size >> 1)) && ((reg)->data->size > 50)) \
     }									 \
 }
 
+/*
+ * The x1 and x2 halves of a BoxRec loaded as one 64-bit word, whatever
+ * the byte order, for comparing the x extents of two boxes at once.
+ */
+static const union {
+    BoxRec box;
+    uint64_t bits;
+} BoxXMask = { { -1, 0, -1, 0 } };
+
 BoxRec RegionEmptyBox = { 0, 0, 0, 0 };
 RegDataRec RegionEmptyData = { 0, 0 };
 
@@ -438,14 +449,24 @@ RegionCoalesce(RegionPtr pReg,  /* Region to coalesce                */
      */
     y2 = pCurBox->y2;
 
-    do {
-        if ((pPrevBox->x1 != pCurBox->x1) || (pPrevBox->x2 != pCurBox->x2)) {
-            return curStart;
+    /*
+     * Compare both x coordinates of a pair of boxes with one masked
+     * 64-bit xor, and don't branch inside the loop so the compiler can
+     * vectorize it for whatever the target supports.
+     */
+    {
+        uint64_t diff = 0, prev, cur;
+        int i;
+
+        for (i = 0; i < numRects; i++) {
+            memcpy(&prev, &pPrevBox[i], sizeof(prev));
+            memcpy(&cur, &pCurBox[i], sizeof(cur));
+            diff |= prev ^ cur;
         }
-        pPrevBox++;
-        pCurBox++;
-        numRects--;
-    } while (numRects);
+        if (diff & BoxXMask.bits)
+            return curStart;
+        pPrevBox += numRects;
+    }
 
     /*
      * The bands may be merged, so set the bottom y of each box
@@ -1048,6 +1069,18 @@ RegionAppend(RegionPtr dstrgn, RegionPtr rgn)
     rects[b] = t;	    \
 }
 
+static Bool
+RectsSorted(BoxRec rects[], int numRects)
+{
+    int i;
+
+    for (i = 1; i < numRects; i++)
+        if (rects[i].y1 < rects[i - 1].y1 ||
+            (rects[i].y1 == rects[i - 1].y1 && rects[i].x1 < rects[i - 1].x1))
+            return FALSE;
+    return TRUE;
+}
+
 static void
 QuickSortRects(BoxRec rects[], int numRects)
 {
@@ -1179,8 +1212,10 @@ RegionValidate(RegionPtr badreg, Bool *pOverlap)
         return TRUE;
     }
 
-    /* Step 1: Sort the rects array into ascending (y1, x1) order */
-    QuickSortRects(RegionBoxptr(badreg), numRects);
+    /* Step 1: Sort the rects array into ascending (y1, x1) order.  Most
+       callers hand us rectangles that already are, so check first. */
+    if (!RectsSorted(RegionBoxptr(badreg), numRects))
+        QuickSortRects(RegionBoxptr(badreg), numRects);
 
     /* Step 2: Scatter the sorted array into the minimum number of regions */
 
@@ -0,0 +1,323 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Per-opcode request profiling.
+ *
+ * Core requests have one counter each; extension requests get a table of
+ * 256 minor opcodes, allocated the first time the extension is used.
+ * Per-client totals are kept by client index and restarted when a new
+ * client issues its first request on that index.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "os.h"
+#include "dixstruct.h"
+#include "opaque.h"
+#include "extnsionst.h"
+#include "registry.h"
+#include "client.h"
+#include "reqprof.h"
+
+#define REQPROF_MINORS 256
+
+typedef struct {
+    CARD64 count;
+    CARD64 total;               /* usec */
+} ReqProfClientRec;
+
+typedef struct {
+    int major, minor;
+    ReqProfPtr prof;
+} ReqProfEntryRec;
+
+Bool RequestProfiling = FALSE;
+volatile char RequestProfileDumpPending = FALSE;
+CallbackListPtr RequestProfileDumpCallback;
+
+static ReqProfRec coreProf[EXTENSION_BASE];
+static ReqProfPtr extProf[256 - EXTENSION_BASE];
+static ReqProfClientRec *clientProf;
+
+#ifdef SIGUSR2
+static void
+RequestProfileSignal(int sig)
+{
+    RequestProfileDumpPending = TRUE;
+}
+#endif
+
+void
+RequestProfileInit(void)
+{
+#ifdef SIGUSR2
+    OsSigHandlerPtr old;
+#endif
+
+    if (clientProf)
+        return;
+
+    clientProf = calloc(LimitClients, sizeof(ReqProfClientRec));
+    if (!clientProf) {
+        LogMessage(X_WARNING, "reqprof: out of memory, profiling disabled\n");
+        RequestProfiling = FALSE;
+        return;
+    }
+
+#ifdef SIGUSR2
+    /* Don't steal the signal from a DDX that switches VTs with it */
+    old = OsSignal(SIGUSR2, RequestProfileSignal);
+    if (old != SIG_DFL) {
+        OsSignal(SIGUSR2, old);
+        LogMessage(X_WARNING, "reqprof: SIGUSR2 is in use, the request "
+                   "profile will only be logged at server reset\n");
+    }
+#endif
+}
+
+static ReqProfPtr
+RequestProfileSlot(int major, int minor, Bool create)
+{
+    ReqProfPtr *table;
+
+    if (major < EXTENSION_BASE)
+        return &coreProf[major];
+    if (minor < 0 || minor >= REQPROF_MINORS)
+        return NULL;
+
+    table = &extProf[major - EXTENSION_BASE];
+    if (!*table && create)
+        *table = calloc(REQPROF_MINORS, sizeof(ReqProfRec));
+    if (!*table)
+        return NULL;
+    return &(*table)[minor];
+}
+
+/*
+ * Account the request just executed by client, which started at time
+ * start as returned by GetTimeInMicros().
+ */
+void
+RequestProfileRecord(ClientPtr client, CARD64 start)
+{
+    CARD64 usec = GetTimeInMicros() - start;
+    CARD64 scaled;
+    ReqProfPtr prof;
+    int bucket;
+
+    if (clientProf && client->index < LimitClients) {
+        ReqProfClientRec *c = &clientProf[client->index];
+
+        /* first request after connection setup */
+        if (client->sequence == 1)
+            c->count = c->total = 0;
+        c->count++;
+        c->total += usec;
+    }
+
+    prof = RequestProfileSlot(client->majorOp, client->minorOp, TRUE);
+    if (!prof)
+        return;
+
+    for (bucket = 0, scaled = usec; scaled && bucket < REQPROF_BUCKETS - 1;
+         bucket++)
+        scaled >>= 1;
+
+    prof->count++;
+    prof->total += usec;
+    if (usec > prof->max)
+        prof->max = usec;
+    prof->hist[bucket]++;
+}
+
+ReqProfPtr
+RequestProfileLookup(int major, int minor)
+{
+    ReqProfPtr prof = RequestProfileSlot(major, minor, FALSE);
+
+    return (prof && prof->count) ? prof : NULL;
+}
+
+static const char *
+RequestProfileName(int major, int minor, char *buf, size_t len)
+{
+#ifdef X_REGISTRY_REQUEST
+    const char *name = LookupRequestName(major, minor);
+
+    if (strcmp(name, XREGISTRY_UNKNOWN) != 0)
+        return name;
+#endif
+    if (major >= EXTENSION_BASE) {
+        ExtensionEntry *ext = GetExtensionEntry(major);
+
+        if (ext) {
+            snprintf(buf, len, "%s:%d", ext->name, minor);
+            return buf;
+        }
+    }
+    snprintf(buf, len, "%d:%d", major, minor);
+    return buf;
+}
+
+/* Upper bound in usec of the bucket holding the given fraction of requests */
+static CARD64
+RequestProfilePercentile(ReqProfPtr prof, int percent)
+{
+    CARD64 want = (prof->count * percent + 99) / 100;
+    CARD64 seen = 0;
+    int i;
+
+    for (i = 0; i < REQPROF_BUCKETS - 1; i++) {
+        seen += prof->hist[i];
+        if (seen >= want)
+            return min((CARD64) 1 << i, prof->max);
+    }
+    return prof->max;
+}
+
+static int
+RequestProfileCompare(const void *a, const void *b)
+{
+    const ReqProfEntryRec *ea = a, *eb = b;
+
+    if (ea->prof->total != eb->prof->total)
+        return ea->prof->total < eb->prof->total ? 1 : -1;
+    return ea->major != eb->major ? ea->major - eb->major :
+        ea->minor - eb->minor;
+}
+
+static int
+RequestProfileCompareClients(const void *a, const void *b)
+{
+    const ClientPtr ca = *(const ClientPtr *) a, cb = *(const ClientPtr *) b;
+    CARD64 ta = clientProf[ca->index].total, tb = clientProf[cb->index].total;
+
+    if (ta != tb)
+        return ta < tb ? 1 : -1;
+    return ca->index - cb->index;
+}
+
+void
+RequestProfileDump(void)
+{
+    ReqProfEntryRec *entries;
+    ClientPtr *active;
+    ReqProfPtr prof;
+    char name[64], hist[REQPROF_BUCKETS * 16];
+    int i, j, n = 0, nclients = 0;
+
+    RequestProfileDumpPending = FALSE;
+    if (!clientProf)
+        return;
+
+    entries = calloc(EXTENSION_BASE + (256 - EXTENSION_BASE) * REQPROF_MINORS,
+                     sizeof(ReqProfEntryRec));
+    active = calloc(currentMaxClients, sizeof(ClientPtr));
+    if (!entries || !active) {
+        free(entries);
+        free(active);
+        return;
+    }
+
+    for (i = 0; i < 256; i++) {
+        for (j = 0; j < (i < EXTENSION_BASE ? 1 : REQPROF_MINORS); j++) {
+            prof = RequestProfileLookup(i, j);
+            if (prof) {
+                entries[n].major = i;
+                entries[n].minor = j;
+                entries[n].prof = prof;
+                n++;
+            }
+        }
+    }
+    qsort(entries, n, sizeof(ReqProfEntryRec), RequestProfileCompare);
+
+    LogMessage(X_INFO, "Request profile: %d opcodes\n", n);
+    LogMessageVerb(X_NONE, 0, "  %-32s %10s %12s %8s %8s %8s %10s\n",
+                   "request", "count", "total(ms)", "avg(us)", "p50(us)",
+                   "p99(us)", "max(us)");
+    for (i = 0; i < n; i++) {
+        int len = 0;
+
+        prof = entries[i].prof;
+        for (j = 0; j < REQPROF_BUCKETS; j++)
+            if (prof->hist[j])
+                len += snprintf(hist + len, sizeof(hist) - len, " %d:%u",
+                                j, (unsigned) prof->hist[j]);
+        hist[len] = '\0';
+
+        LogMessageVerb(X_NONE, 0,
+                       "  %-32s %10llu %12.3f %8llu %8llu %8llu %10llu\n",
+                       RequestProfileName(entries[i].major, entries[i].minor,
+                                          name, sizeof(name)),
+                       (unsigned long long) prof->count,
+                       prof->total / 1000.0,
+                       (unsigned long long) (prof->total / prof->count),
+                       (unsigned long long) RequestProfilePercentile(prof, 50),
+                       (unsigned long long) RequestProfilePercentile(prof, 99),
+                       (unsigned long long) prof->max);
+        LogMessageVerb(X_NONE, 0, "  %-32s log2(us) buckets:%s\n", "", hist);
+    }
+
+    for (i = 1; i < currentMaxClients; i++)
+        if (clients[i] && clients[i]->sequence &&
+            clientProf[clients[i]->index].count)
+            active[nclients++] = clients[i];
+    qsort(active, nclients, sizeof(ClientPtr), RequestProfileCompareClients);
+
+    LogMessage(X_INFO, "Request profile: %d clients\n", nclients);
+    for (i = 0; i < nclients; i++) {
+        ReqProfClientRec *c = &clientProf[active[i]->index];
+        const char *cmd = GetClientCmdName(active[i]);
+
+        LogMessageVerb(X_NONE, 0, "  client %-4d pid %-7ld %-24s %10llu "
+                       "requests %12.3f ms\n", active[i]->index,
+                       (long) GetClientPid(active[i]), cmd ? cmd : "?",
+                       (unsigned long long) c->count, c->total / 1000.0);
+    }
+
+    free(entries);
+    free(active);
+}
+
+void
+RequestProfileReset(void)
+{
+    int i;
+
+    memset(coreProf, 0, sizeof(coreProf));
+    for (i = 0; i < (int) ARRAY_SIZE(extProf); i++) {
+        free(extProf[i]);
+        extProf[i] = NULL;
+    }
+    if (clientProf)
+        memset(clientProf, 0, LimitClients * sizeof(ReqProfClientRec));
+}
@@ -151,6 +151,8 @@ Equipment Corporation.
 
 static void RebuildTable(int    /*client */
     );
+static void RebuildTableStep(int        /*client */
+    );
 
 #define SERVER_MINID 32
 
@@ -158,6 +160,9 @@ static void RebuildTable(int    /*client */
 #define INITHASHSIZE 6
 #define MAXHASHSIZE 16
 
+/* buckets of the old table moved to the new one per AddResource */
+#define REHASH_STEP 4
+
 typedef struct _Resource {
     struct _Resource *next;
     XID id;
@@ -165,11 +170,25 @@ typedef struct _Resource {
     void *value;
 } ResourceRec, *ResourcePtr;
 
+/*
+ * When a client's table fills up, RebuildTable allocates one twice the
+ * size and RebuildTableStep moves the old buckets over a few at a time on
+ * the following insertions, so no single request pays for rehashing all
+ * of the client's resources.  Until it is done, an ID whose bucket in the
+ * old table has not been moved yet lives in the old table.
+ *
+ * Walking the buckets while resources are added must not move them
+ * around, so the walkers bump "walking" to hold off the migration.
+ */
 typedef struct _ClientResource {
     ResourcePtr *resources;
     int elements;
     int buckets;
     int hashsize;               /* log(2)(buckets) */
+    ResourcePtr *oldResources;  /* table being migrated, or NULL */
+    int oldBuckets;
+    int migrated;               /* buckets of oldResources moved so far */
+    int walking;
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
@@ -651,6 +670,10 @@ InitClientResources(ClientPtr client)
     clientTable[i].buckets = INITBUCKETS;
     clientTable[i].elements = 0;
     clientTable[i].hashsize = INITHASHSIZE;
+    clientTable[i].oldResources = NULL;
+    clientTable[i].oldBuckets = 0;
+    clientTable[i].migrated = 0;
+    clientTable[i].walking = 0;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
@@ -665,6 +688,16 @@ InitClientResources(ClientPtr client)
     return TRUE;
 }
 
+/*
+ * Fold the high bits of the ID into the low ones.  Unlike the old fold,
+ * this one doesn't depend on the table size: the hash for numBits is the
+ * hash for numBits + 1 without its top bit, so a table that doubles in
+ * size splits bucket b into buckets b and b + half, which is what lets
+ * RebuildTableStep move one bucket at a time.  Every hash bit is the
+ * matching ID bit xor higher ones, so an aligned run of as many
+ * consecutive IDs as there are buckets fills each bucket exactly once,
+ * and IDs allocated together stay in nearby buckets.
+ */
 int
 HashResourceID(XID id, int numBits)
 {
@@ -673,9 +706,47 @@ HashResourceID(XID id, int numBits)
     if (!mask)
         mask = RESOURCE_ID_MASK;
     id &= mask;
-    if (numBits < 9)
-        return (id ^ (id >> numBits) ^ (id >> (numBits<<1))) & ~((~0) << numBits);
-    return (id ^ (id >> numBits)) & ~((~0) << numBits);
+    id ^= (id >> 6) ^ (id >> 12) ^ (id >> 18);
+    if (numBits <= 0)
+        return 0;
+    if (numBits > 31)
+        numBits = 31;
+    return id & ((1U << numBits) - 1);
+}
+
+/* The chain id hashes to, in whichever table currently holds it */
+static ResourcePtr *
+ResourceBucket(ClientResourceRec *rrec, XID id)
+{
+    if (rrec->oldResources) {
+        int old = HashResourceID(id, rrec->hashsize - 1);
+
+        if (old >= rrec->migrated)
+            return &rrec->oldResources[old];
+    }
+    return &rrec->resources[HashResourceID(id, rrec->hashsize)];
+}
+
+/* Number of chains, for walking them with ResourceBucketAt */
+static int
+ResourceBucketCount(ClientResourceRec *rrec)
+{
+    if (rrec->oldResources)
+        return rrec->buckets + rrec->oldBuckets - rrec->migrated;
+    return rrec->buckets;
+}
+
+static ResourcePtr *
+ResourceBucketAt(ClientResourceRec *rrec, int i)
+{
+    if (rrec->oldResources) {
+        int left = rrec->oldBuckets - rrec->migrated;
+
+        if (i < left)
+            return &rrec->oldResources[rrec->migrated + i];
+        i -= left;
+    }
+    return &rrec->resources[i];
 }
 
 static XID
@@ -686,7 +757,7 @@ AvailableID(int client, XID id, XID maxid, XID goodid)
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
+        res = *ResourceBucket(&clientTable[client], id);
         while (res && (res->id != id))
             res = res->next;
         if (!res)
@@ -699,7 +770,6 @@ void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
     XID id, maxid;
-    ResourcePtr *resp;
     ResourcePtr res;
     int i;
     XID goodid;
@@ -709,9 +779,9 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
+    for (i = ResourceBucketCount(&clientTable[client]); --i >= 0;) {
+        for (res = *ResourceBucketAt(&clientTable[client], i); res;
+             res = res->next) {
             if ((res->id < id) || (res->id > maxid))
                 continue;
             if (((res->id - id) >= (maxid - res->id)) ?
@@ -810,9 +880,12 @@ AddResource(XID id, RESTYPE type, void *value)
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
+    if (rrec->oldResources && !rrec->walking)
+        RebuildTableStep(client);
+    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE)
+        && !rrec->oldResources)
         RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
+    head = ResourceBucket(rrec, id);
     res = malloc(sizeof(ResourceRec));
     if (!res) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
@@ -831,44 +904,56 @@ AddResource(XID id, RESTYPE type, void *value)
 static void
 RebuildTable(int client)
 {
-    int j;
+    ClientResourceRec *rrec = &clientTable[client];
+    ResourcePtr *resources;
+
+    resources = calloc(2 * rrec->buckets, sizeof(ResourcePtr));
+    if (!resources)
+        return;
+
+    rrec->oldResources = rrec->resources;
+    rrec->oldBuckets = rrec->buckets;
+    rrec->migrated = 0;
+    rrec->resources = resources;
+    rrec->buckets *= 2;
+    rrec->hashsize++;
+}
+
+static void
+RebuildTableStep(int client)
+{
+    ClientResourceRec *rrec = &clientTable[client];
     ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
+    ResourcePtr *tails[2];
+    int b, n;
 
     /*
      * For now, preserve insertion order, since some ddx layers depend
      * on resources being free in the opposite order they are added.
+     * Old bucket b only ever feeds new buckets b and b + oldBuckets,
+     * and those stay empty until b has been moved.
      */
 
-    j = 2 * clientTable[client].buckets;
-    tails =  xallocarray(j, sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources =  xallocarray(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
+    for (n = 0; n < REHASH_STEP && rrec->migrated < rrec->oldBuckets; n++) {
+        b = rrec->migrated;
+        tails[0] = &rrec->resources[b];
+        tails[1] = &rrec->resources[b + rrec->oldBuckets];
+        for (res = rrec->oldResources[b]; res; res = next) {
             next = res->next;
             res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
+            b = HashResourceID(res->id, rrec->hashsize) >= rrec->oldBuckets;
+            *tails[b] = res;
+            tails[b] = &res->next;
         }
+        rrec->oldResources[rrec->migrated++] = NULL;
+    }
+
+    if (rrec->migrated == rrec->oldBuckets) {
+        free(rrec->oldResources);
+        rrec->oldResources = NULL;
+        rrec->oldBuckets = 0;
+        rrec->migrated = 0;
     }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
 }
 
 static void
@@ -892,7 +977,7 @@ FreeResource(XID id, RESTYPE skipDeleteFuncType)
     int elements;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        head = ResourceBucket(&clientTable[cid], id);
         eltptr = &clientTable[cid].elements;
 
         prev = head;
@@ -926,7 +1011,7 @@ FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
     ResourcePtr *prev, *head;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        head = ResourceBucket(&clientTable[cid], id);
 
         prev = head;
         while ((res = *prev)) {
@@ -961,7 +1046,7 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
     ResourcePtr res;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if ((res->id == id) && (res->type == rtype)) {
@@ -982,7 +1067,8 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourcePtr *bucket;
     ResourcePtr this, next;
     int i, elements;
     int *eltptr;
@@ -990,19 +1076,22 @@ FindClientResourcesByType(ClientPtr client,
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    eltptr = &rrec->elements;
+    rrec->walking++;
+    for (i = 0; i < ResourceBucketCount(rrec); i++) {
+        bucket = ResourceBucketAt(rrec, i);
+        for (this = *bucket; this; this = next) {
             next = this->next;
             if (!type || this->type == type) {
                 elements = *eltptr;
                 (*func) (this->value, this->id, cdata);
                 if (*eltptr != elements)
-                    next = resources[i];        /* start over */
+                    next = *bucket;     /* start over */
             }
         }
     }
+    rrec->walking--;
 }
 
 void FindSubResources(void *resource,
@@ -1017,7 +1106,8 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourcePtr *bucket;
     ResourcePtr this, next;
     int i, elements;
     int *eltptr;
@@ -1025,17 +1115,20 @@ FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    eltptr = &rrec->elements;
+    rrec->walking++;
+    for (i = 0; i < ResourceBucketCount(rrec); i++) {
+        bucket = ResourceBucketAt(rrec, i);
+        for (this = *bucket; this; this = next) {
             next = this->next;
             elements = *eltptr;
             (*func) (this->value, this->id, this->type, cdata);
             if (*eltptr != elements)
-                next = resources[i];    /* start over */
+                next = *bucket; /* start over */
         }
     }
+    rrec->walking--;
 }
 
 void *
@@ -1043,7 +1136,7 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this, next;
     void *value;
     int i;
@@ -1051,25 +1144,30 @@ LookupClientResourceComplex(ClientPtr client,
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    rrec->walking++;
+    for (i = 0; i < ResourceBucketCount(rrec); i++) {
+        for (this = *ResourceBucketAt(rrec, i); this; this = next) {
             next = this->next;
             if (!type || this->type == type) {
                 /* workaround func freeing the type as DRI1 does */
                 value = this->value;
-                if ((*func) (value, this->id, cdata))
+                if ((*func) (value, this->id, cdata)) {
+                    rrec->walking--;
                     return value;
+                }
             }
         }
     }
+    rrec->walking--;
     return NULL;
 }
 
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourcePtr *bucket;
     ResourcePtr this;
     ResourcePtr *prev;
     int j, elements;
@@ -1078,10 +1176,12 @@ FreeClientNeverRetainResources(ClientPtr client)
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
+    rrec = &clientTable[client->index];
+    eltptr = &rrec->elements;
+    rrec->walking++;
+    for (j = 0; j < ResourceBucketCount(rrec); j++) {
+        bucket = ResourceBucketAt(rrec, j);
+        prev = bucket;
         while ((this = *prev)) {
             RESTYPE rtype = this->type;
 
@@ -1097,18 +1197,19 @@ FreeClientNeverRetainResources(ClientPtr client)
                 doFreeResource(this, FALSE);
 
                 if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
+                    prev = bucket;      /* prev may no longer be valid */
             }
             else
                 prev = &this->next;
         }
     }
+    rrec->walking--;
 }
 
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this;
     int j;
 
@@ -1120,8 +1221,9 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
+    rrec = &clientTable[client->index];
+    rrec->walking++;
+    for (j = 0; j < ResourceBucketCount(rrec); j++) {
         /* It may seem silly to update the head of this resource list as
            we delete the members, since the entire list will be deleted any way,
            but there are some resource deletion functions "FreeClientPixels" for
@@ -1133,7 +1235,7 @@ FreeClientResources(ClientPtr client)
 
         ResourcePtr *head;
 
-        head = &resources[j];
+        head = ResourceBucketAt(rrec, j);
 
         for (this = *head; this; this = *head) {
 #ifdef XSERVER_DTRACE
@@ -1146,9 +1248,14 @@ FreeClientResources(ClientPtr client)
             doFreeResource(this, FALSE);
         }
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    rrec->walking--;
+    free(rrec->oldResources);
+    rrec->oldResources = NULL;
+    rrec->oldBuckets = 0;
+    rrec->migrated = 0;
+    free(rrec->resources);
+    rrec->resources = NULL;
+    rrec->buckets = 0;
 }
 
 void
@@ -1199,7 +1306,7 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
         return BadImplementation;
 
     if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if (res->id == id && res->type == rtype)
@@ -1234,7 +1341,7 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
     *result = NULL;
 
     if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if (res->id == id && (res->type & rclass))
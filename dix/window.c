@@ -608,6 +608,7 @@ CreateRootWindow(ScreenPtr pScreen)
     pWin->optional->inputShape = NULL;
     pWin->optional->inputMasks = NULL;
     pWin->optional->deviceCursors = NULL;
+    pWin->optional->userPropIndex = NULL;
     pWin->optional->colormap = pScreen->defColormap;
     pWin->optional->visual = pScreen->rootVisual;
 
@@ -753,6 +754,212 @@ RealChildHead(WindowPtr pWin)
         return NullWindow;
 }
 
+/*
+ * Screens with many top-level windows keep a grid over the root window
+ * listing, for every cell, the mapped top-level windows whose border box
+ * intersects it, in stacking order.  Pointer picking then only has to look
+ * at the windows of one cell instead of every child of the root.
+ *
+ * The index is rebuilt lazily: changes to the children of a root only mark
+ * it stale, and lookups keep falling back to walking the children until
+ * the tree has been quiet for a few lookups, so a window being dragged does
+ * not cause a rebuild on every motion event.
+ */
+
+#define TOPLEVEL_INDEX_THRESHOLD        64      /* top-level windows */
+#define TOPLEVEL_INDEX_CELL             64      /* minimum cell size */
+#define TOPLEVEL_INDEX_MAX_CELLS        32      /* per axis */
+#define TOPLEVEL_INDEX_MAX_ENTRIES      (1 << 20)
+#define TOPLEVEL_INDEX_QUIET            16      /* lookups before rebuild */
+
+typedef struct _TopLevelIndex {
+    Bool stale;
+    int quiet;
+    WindowPtr root;             /* the index was built for */
+    int width, height;          /* of the root when built */
+    int cellWidth, cellHeight;
+    int cols, rows;             /* 0 when the root has few children */
+    int *start;                 /* cols * rows + 1 offsets into windows */
+    WindowPtr *windows;
+} TopLevelIndexRec, *TopLevelIndexPtr;
+
+static TopLevelIndexPtr topLevelIndex[MAXSCREENS];
+
+static void
+TopLevelIndexFree(TopLevelIndexPtr index)
+{
+    free(index->start);
+    free(index->windows);
+    index->start = NULL;
+    index->windows = NULL;
+    index->cols = index->rows = 0;
+}
+
+/* Note a change to the children of pParent, if it is a root window */
+static void
+TopLevelIndexChanged(WindowPtr pParent)
+{
+    TopLevelIndexPtr index;
+
+    if (!pParent || pParent->parent ||
+        pParent->drawable.pScreen->myNum >= MAXSCREENS)
+        return;
+    index = topLevelIndex[pParent->drawable.pScreen->myNum];
+    if (index) {
+        index->stale = TRUE;
+        index->quiet = 0;
+    }
+}
+
+static void
+TopLevelIndexDestroy(ScreenPtr pScreen)
+{
+    if (pScreen->myNum >= MAXSCREENS || !topLevelIndex[pScreen->myNum])
+        return;
+    TopLevelIndexFree(topLevelIndex[pScreen->myNum]);
+    free(topLevelIndex[pScreen->myNum]);
+    topLevelIndex[pScreen->myNum] = NULL;
+}
+
+/* The range of cells covered by the border box of pWin, FALSE if none */
+static Bool
+TopLevelIndexCells(TopLevelIndexPtr index, WindowPtr pWin, BoxPtr cells)
+{
+    int bw = wBorderWidth(pWin);
+    int x1 = pWin->drawable.x - bw, y1 = pWin->drawable.y - bw;
+    int x2 = pWin->drawable.x + (int) pWin->drawable.width + bw;
+    int y2 = pWin->drawable.y + (int) pWin->drawable.height + bw;
+
+    if (x1 < 0)
+        x1 = 0;
+    if (y1 < 0)
+        y1 = 0;
+    if (x2 > index->width)
+        x2 = index->width;
+    if (y2 > index->height)
+        y2 = index->height;
+    if (x1 >= x2 || y1 >= y2)
+        return FALSE;
+    cells->x1 = x1 / index->cellWidth;
+    cells->y1 = y1 / index->cellHeight;
+    cells->x2 = (x2 - 1) / index->cellWidth + 1;
+    cells->y2 = (y2 - 1) / index->cellHeight + 1;
+    return TRUE;
+}
+
+static void
+TopLevelIndexBuild(TopLevelIndexPtr index, WindowPtr pRoot)
+{
+    WindowPtr pWin;
+    BoxRec cells;
+    int *fill;
+    int n = 0, ncells, total, cx, cy, i;
+
+    TopLevelIndexFree(index);
+    index->stale = FALSE;
+    index->root = pRoot;
+    index->width = pRoot->drawable.width;
+    index->height = pRoot->drawable.height;
+
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib)
+        if (pWin->mapped)
+            n++;
+    if (n < TOPLEVEL_INDEX_THRESHOLD || !index->width || !index->height)
+        return;
+
+    index->cellWidth = max(TOPLEVEL_INDEX_CELL,
+                           (index->width + TOPLEVEL_INDEX_MAX_CELLS - 1) /
+                           TOPLEVEL_INDEX_MAX_CELLS);
+    index->cellHeight = max(TOPLEVEL_INDEX_CELL,
+                            (index->height + TOPLEVEL_INDEX_MAX_CELLS - 1) /
+                            TOPLEVEL_INDEX_MAX_CELLS);
+    index->cols = (index->width + index->cellWidth - 1) / index->cellWidth;
+    index->rows = (index->height + index->cellHeight - 1) / index->cellHeight;
+    ncells = index->cols * index->rows;
+
+    index->start = calloc(ncells + 1, sizeof(int));
+    fill = calloc(ncells, sizeof(int));
+    if (!index->start || !fill)
+        goto fail;
+
+    /* count the windows of each cell, then turn counts into offsets */
+    total = 0;
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib) {
+        if (!pWin->mapped || !TopLevelIndexCells(index, pWin, &cells))
+            continue;
+        total += (cells.x2 - cells.x1) * (cells.y2 - cells.y1);
+        if (total > TOPLEVEL_INDEX_MAX_ENTRIES)
+            goto fail;
+        for (cy = cells.y1; cy < cells.y2; cy++)
+            for (cx = cells.x1; cx < cells.x2; cx++)
+                index->start[cy * index->cols + cx + 1]++;
+    }
+    for (i = 0; i < ncells; i++) {
+        index->start[i + 1] += index->start[i];
+        fill[i] = index->start[i];
+    }
+
+    index->windows = calloc(max(total, 1), sizeof(WindowPtr));
+    if (!index->windows)
+        goto fail;
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib) {
+        if (!pWin->mapped || !TopLevelIndexCells(index, pWin, &cells))
+            continue;
+        for (cy = cells.y1; cy < cells.y2; cy++)
+            for (cx = cells.x1; cx < cells.x2; cx++)
+                index->windows[fill[cy * index->cols + cx]++] = pWin;
+    }
+    free(fill);
+    return;
+
+ fail:
+    free(fill);
+    TopLevelIndexFree(index);
+}
+
+/*
+ * The mapped children of pRoot whose border box may contain x/y, in
+ * stacking order, or NULL when there is no index for the screen of pRoot.
+ * Callers must then walk the children of pRoot themselves.
+ */
+WindowPtr *
+TopLevelWindowsAt(WindowPtr pRoot, int x, int y, int *nwin)
+{
+    TopLevelIndexPtr index;
+    int cell;
+
+    if (pRoot->parent || pRoot->drawable.pScreen->myNum >= MAXSCREENS)
+        return NULL;
+
+    index = topLevelIndex[pRoot->drawable.pScreen->myNum];
+    if (!index) {
+        index = calloc(1, sizeof(TopLevelIndexRec));
+        if (!index)
+            return NULL;
+        index->stale = TRUE;
+        topLevelIndex[pRoot->drawable.pScreen->myNum] = index;
+    }
+
+    if (index->root != pRoot || index->width != pRoot->drawable.width ||
+        index->height != pRoot->drawable.height) {
+        TopLevelIndexFree(index);
+        index->stale = TRUE;
+    }
+    if (index->stale) {
+        if (++index->quiet < TOPLEVEL_INDEX_QUIET)
+            return NULL;
+        TopLevelIndexBuild(index, pRoot);
+    }
+
+    if (!index->cols || x < 0 || y < 0 ||
+        x >= index->width || y >= index->height)
+        return NULL;
+
+    cell = (y / index->cellHeight) * index->cols + x / index->cellWidth;
+    *nwin = index->start[cell + 1] - index->start[cell];
+    return index->windows + index->start[cell];
+}
+
 /*****
  * CreateWindow
  *    Makes a window in response to client request
@@ -1040,6 +1247,7 @@ CrushTree(WindowPtr pWin)
 
     if (!(pChild = pWin->firstChild))
         return;
+    TopLevelIndexChanged(pWin);
     UnrealizeWindow = pWin->drawable.pScreen->UnrealizeWindow;
     while (1) {
         if (pChild->firstChild) {
@@ -1106,9 +1314,12 @@ DeleteWindow(void *value, XID wid)
             pWin->nextSib->prevSib = pWin->prevSib;
         if (pWin->prevSib)
             pWin->prevSib->nextSib = pWin->nextSib;
+        TopLevelIndexChanged(pParent);
     }
-    else
+    else {
+        TopLevelIndexDestroy(pWin->drawable.pScreen);
         pWin->drawable.pScreen->root = NULL;
+    }
     dixFreeObjectWithPrivates(pWin, PRIVATE_WINDOW);
     return Success;
 }
@@ -1648,6 +1859,7 @@ MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
     if (pWin->nextSib != pNextSib) {
         WindowPtr pOldNextSib = pWin->nextSib;
 
+        TopLevelIndexChanged(pParent);
         if (!pNextSib) {        /* move to bottom */
             if (pParent->firstChild == pWin)
                 pParent->firstChild = pWin->nextSib;
@@ -1759,6 +1971,7 @@ SetBorderSize(WindowPtr pWin)
 {
     int bw;
 
+    TopLevelIndexChanged(pWin->parent);
     if (HasBorder(pWin)) {
         bw = wBorderWidth(pWin);
 #ifdef COMPOSITE
@@ -2557,6 +2770,7 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
         pWin->nextSib->prevSib = pWin->prevSib;
     if (pWin->prevSib)
         pWin->prevSib->nextSib = pWin->nextSib;
+    TopLevelIndexChanged(pPriorParent);
 
     /* insert at begining of pParent */
     pWin->parent = pParent;
@@ -2686,6 +2900,7 @@ MapWindow(WindowPtr pWin, ClientPtr client)
                 return Success;
 
         pWin->mapped = TRUE;
+        TopLevelIndexChanged(pParent);
         if (SubStrSend(pWin, pParent))
             DeliverMapNotify(pWin);
 
@@ -2754,6 +2969,7 @@ MapSubwindows(WindowPtr pParent, ClientPtr client)
                     continue;
 
             pWin->mapped = TRUE;
+            TopLevelIndexChanged(pParent);
             if (parentNotify || StrSend(pWin))
                 DeliverMapNotify(pWin);
 
@@ -2870,6 +3086,7 @@ UnmapWindow(WindowPtr pWin, Bool fromConfigure)
         (*pScreen->MarkWindow) (pLayerWin->parent);
     }
     pWin->mapped = FALSE;
+    TopLevelIndexChanged(pParent);
     if (wasRealized)
         UnrealizeTree(pWin, fromConfigure);
     if (wasViewable) {
@@ -2921,6 +3138,7 @@ UnmapSubwindows(WindowPtr pWin)
                 anyMarked = TRUE;
             }
             pChild->mapped = FALSE;
+            TopLevelIndexChanged(pWin);
             if (pChild->realized)
                 UnrealizeTree(pChild, FALSE);
         }
@@ -2983,8 +3201,10 @@ HandleSaveSet(ClientPtr client)
                                pParent->drawable.x,
                                pWin->drawable.y - wBorderWidth(pWin) -
                                pParent->drawable.y, client);
-                if (!pWin->realized && pWin->mapped)
+                if (!pWin->realized && pWin->mapped) {
                     pWin->mapped = FALSE;
+                    TopLevelIndexChanged(pWin->parent);
+                }
             }
             if (SaveSetShouldMap(client->saveSet[j]))
                 MapWindow(pWin, client);
@@ -3428,6 +3648,7 @@ MakeWindowOptional(WindowPtr pWin)
     optional->inputShape = NULL;
     optional->inputMasks = NULL;
     optional->deviceCursors = NULL;
+    optional->userPropIndex = NULL;
 
     parentOptional = FindWindowWithOptional(pWin)->optional;
     optional->visual = parentOptional->visual;
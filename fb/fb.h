@@ -410,6 +410,7 @@ typedef struct {
 #endif
     DevPrivateKeyRec    gcPrivateKeyRec;
     DevPrivateKeyRec    winPrivateKeyRec;
+    DevPrivateKeyRec    pixmapPrivateKeyRec;        /* pool size class */
 } FbScreenPrivRec, *FbScreenPrivPtr;
 
 #define fbGetScreenPrivate(pScreen) ((FbScreenPrivPtr) \
@@ -969,6 +970,22 @@ extern _X_EXPORT Bool
 extern _X_EXPORT RegionPtr
  fbPixmapToRegion(PixmapPtr pPix);
 
+/* pixmap memory pool counters */
+typedef struct _FbPixmapPoolStats {
+    unsigned long hits;         /* pixmaps allocated from the pool */
+    unsigned long misses;       /* pixmaps that needed a new block */
+    unsigned long unpooled;     /* pixmaps too large for the pool */
+    unsigned long released;     /* blocks freed because the pool was full */
+    unsigned long pooled;       /* blocks currently pooled */
+    unsigned long pooled_bytes;
+} FbPixmapPoolStatsRec, *FbPixmapPoolStatsPtr;
+
+extern _X_EXPORT void
+fbGetPixmapPoolStats(FbPixmapPoolStatsPtr stats);
+
+extern _X_EXPORT void
+fbFlushPixmapPool(void);
+
 /*
  * fbpoint.c
  */
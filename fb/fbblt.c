@@ -90,6 +90,23 @@ fbBlt(FbBits * srcLine,
 
             return;
         }
+#ifndef FB_ACCESS_WRAPPER
+        /*
+         * Rows of the same pixmap can only overlap when they are the same
+         * row, as when scrolling sideways, and memmove handles that case
+         * in whichever direction is needed
+         */
+        if (src_byte_stride == dst_byte_stride) {
+            int i;
+
+            for (i = 0; i < height; i++)
+                memmove(dst_byte + i * dst_byte_stride,
+                        src_byte + i * src_byte_stride,
+                        width_byte);
+
+            return;
+        }
+#endif
     }
 
     FbInitializeMergeRop(alu, pm);
@@ -27,6 +27,60 @@
 #include <stdlib.h>
 
 #include "fb.h"
+#include "fbthread.h"
+
+#ifdef FB_THREADS
+typedef struct _fbCopyRows {
+    FbBits *src;
+    FbStride srcStride;
+    int srcX;
+    FbBits *dst;
+    FbStride dstStride;
+    int dstX;
+    int width;
+    int bpp;
+} FbCopyRowsRec, *FbCopyRowsPtr;
+
+static void
+fbCopyRows(void *closure, int y1, int y2)
+{
+    FbCopyRowsPtr copy = closure;
+
+    fbBlt(copy->src + y1 * copy->srcStride, copy->srcStride, copy->srcX,
+          copy->dst + y1 * copy->dstStride, copy->dstStride, copy->dstX,
+          copy->width, y2 - y1, GXcopy, FB_ALLONES, copy->bpp, FALSE, FALSE);
+}
+
+/*
+ * GXcopy a large box in bands of rows on the render threads.  The bands
+ * run in no particular order, so this is only done when the source and
+ * destination rows don't share any memory.
+ */
+static Bool
+fbCopyBoxThreaded(FbBits *src, FbStride srcStride, int srcX,
+                  FbBits *dst, FbStride dstStride, int dstX,
+                  int width, int height, int bpp)
+{
+    FbCopyRowsRec copy;
+
+    if ((CARD32) (width / bpp) * height < FB_THREAD_MIN_PIXELS)
+        return FALSE;
+
+    if (src < dst + height * dstStride && dst < src + height * srcStride)
+        return FALSE;
+
+    copy.src = src;
+    copy.srcStride = srcStride;
+    copy.srcX = srcX;
+    copy.dst = dst;
+    copy.dstStride = dstStride;
+    copy.dstX = dstX;
+    copy.width = width;
+    copy.bpp = bpp;
+
+    return fbThreadRows(fbCopyRows, &copy, height, FALSE);
+}
+#endif
 
 void
 fbCopyNtoN(DrawablePtr pSrcDrawable,
@@ -52,6 +106,18 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
     fbGetDrawable(pDstDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
 
     while (nbox--) {
+#ifdef FB_THREADS
+        if (pm == FB_ALLONES && alu == GXcopy && srcBpp == dstBpp &&
+            fbCopyBoxThreaded(src + (pbox->y1 + dy + srcYoff) * srcStride,
+                              srcStride,
+                              (pbox->x1 + dx + srcXoff) * srcBpp,
+                              dst + (pbox->y1 + dstYoff) * dstStride,
+                              dstStride,
+                              (pbox->x1 + dstXoff) * dstBpp,
+                              (pbox->x2 - pbox->x1) * dstBpp,
+                              (pbox->y2 - pbox->y1), dstBpp))
+            goto next;
+#endif
 #ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
         if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown) {
             if (!pixman_blt
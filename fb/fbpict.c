@@ -34,6 +34,84 @@
 #include "picturestr.h"
 #include "mipict.h"
 #include "fbpict.h"
+#include "fbthread.h"
+
+#ifdef FB_THREADS
+typedef struct _fbCompositeJob {
+    pixman_op_t op;
+    pixman_image_t *src, *mask, *dest;
+    int16_t src_x, src_y, mask_x, mask_y, dest_x, dest_y;
+    uint16_t width;
+} fbCompositeJobRec, *fbCompositeJobPtr;
+
+static void
+fbCompositeRows(void *closure, int y1, int y2)
+{
+    fbCompositeJobPtr job = closure;
+
+    pixman_image_composite32(job->op, job->src, job->mask, job->dest,
+                             job->src_x, job->src_y + y1,
+                             job->mask_x, job->mask_y + y1,
+                             job->dest_x, job->dest_y + y1,
+                             job->width, y2 - y1);
+}
+
+static Bool
+fbSharesBits(pixman_image_t *image, pixman_image_t *dest)
+{
+    return image && pixman_image_get_data(image) &&
+        pixman_image_get_data(image) == pixman_image_get_data(dest);
+}
+
+/*
+ * Run a composite as horizontal tiles on the render threads.  Each tile
+ * is the same operation on a subset of the destination rows, so the
+ * result matches a single pixman_image_composite() bit for bit.  Returns
+ * FALSE, leaving the work to the caller, when the operation is too small
+ * to be worth it or cannot be split safely.
+ */
+static Bool
+fbCompositeThreaded(pixman_op_t op,
+                    PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst,
+                    pixman_image_t *src, pixman_image_t *mask,
+                    pixman_image_t *dest,
+                    int16_t src_x, int16_t src_y,
+                    int16_t mask_x, int16_t mask_y,
+                    int16_t dest_x, int16_t dest_y,
+                    uint16_t width, uint16_t height)
+{
+    fbCompositeJobRec job;
+
+    if ((CARD32) width * height < FB_THREAD_MIN_PIXELS)
+        return FALSE;
+
+    /* alpha maps are separate images the tiles would all write */
+    if (pSrc->alphaMap || (pMask && pMask->alphaMap) || pDst->alphaMap)
+        return FALSE;
+
+    /* reading pixels another tile writes depends on the order of tiles */
+    if (fbSharesBits(src, dest) || fbSharesBits(mask, dest))
+        return FALSE;
+
+    job.op = op;
+    job.src = src;
+    job.mask = mask;
+    job.dest = dest;
+    job.src_x = src_x;
+    job.src_y = src_y;
+    job.mask_x = mask_x;
+    job.mask_y = mask_y;
+    job.dest_x = dest_x;
+    job.dest_y = dest_y;
+    job.width = width;
+
+    /*
+     * pixman validates images lazily on first use, writing to them, so
+     * the first tile runs alone before the images are shared.
+     */
+    return fbThreadRows(fbCompositeRows, &job, height, TRUE);
+}
+#endif
 
 void
 fbComposite(CARD8 op,
@@ -59,6 +137,13 @@ fbComposite(CARD8 op,
     dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
     if (src && dest && !(pMask && !mask)) {
+#ifdef FB_THREADS
+        if (!fbCompositeThreaded(op, pSrc, pMask, pDst, src, mask, dest,
+                                 xSrc + src_xoff, ySrc + src_yoff,
+                                 xMask + msk_xoff, yMask + msk_yoff,
+                                 xDst + dst_xoff, yDst + dst_yoff,
+                                 width, height))
+#endif
         pixman_image_composite(op, src, mask, dest,
                                xSrc + src_xoff, ySrc + src_yoff,
                                xMask + msk_xoff, yMask + msk_yoff,
@@ -90,6 +175,69 @@ fbUnrealizeGlyph(ScreenPtr pScreen,
 	pixman_glyph_cache_remove (glyphCache, pGlyph, NULL);
 }
 
+/*
+ * Tracks whether the glyphs of a run are disjoint, assuming they are laid
+ * out in rows running left to right, each row below the previous ones.
+ */
+typedef struct _fbGlyphsDisjoint {
+    Bool disjoint;
+    Bool any;
+    int prevY2;                 /* bottom of the rows before this one */
+    int rowX2, rowY2;           /* right and bottom of this row */
+} FbGlyphsDisjointRec;
+
+static void
+fbGlyphsCheckDisjoint(FbGlyphsDisjointRec *d, GlyphPtr glyph, int x, int y)
+{
+    int x1 = x - glyph->info.x, x2 = x1 + glyph->info.width;
+    int y1 = y - glyph->info.y, y2 = y1 + glyph->info.height;
+
+    if (!d->disjoint || x1 == x2 || y1 == y2)
+        return;
+
+    if (!d->any || y1 >= max(d->prevY2, d->rowY2)) {
+        /* below everything so far, starts a new row */
+        if (d->any)
+            d->prevY2 = max(d->prevY2, d->rowY2);
+        else
+            d->prevY2 = y1;
+        d->any = TRUE;
+        d->rowX2 = x2;
+        d->rowY2 = y2;
+    }
+    else if (y1 >= d->prevY2 && x1 >= d->rowX2) {
+        /* right of everything in this row */
+        d->rowX2 = x2;
+        d->rowY2 = max(d->rowY2, y2);
+    }
+    else
+        d->disjoint = FALSE;
+}
+
+/*
+ * Without a mask format each glyph is composited on its own.  When no two
+ * glyphs overlap and the operator leaves the destination alone where the
+ * source is transparent, adding the glyphs into one mask and compositing
+ * through that gives the same pixels in a single operation.  Returns the
+ * mask format to do that with, or 0 if the run must go glyph by glyph.
+ */
+static pixman_format_code_t
+fbGlyphsBatchFormat(CARD8 op, FbGlyphsDisjointRec *d,
+                    int n_glyphs, const pixman_glyph_t *pglyphs)
+{
+    pixman_format_code_t format;
+
+    if ((op != PictOpOver && op != PictOpAdd) || !d->disjoint || n_glyphs < 2)
+        return 0;
+
+    /* component alpha glyphs would change meaning in an ARGB mask */
+    format = pixman_glyph_get_mask_format(glyphCache, n_glyphs, pglyphs);
+    if (PIXMAN_FORMAT_TYPE(format) != PIXMAN_TYPE_A)
+        return 0;
+
+    return format;
+}
+
 void
 fbGlyphs(CARD8 op,
 	 PicturePtr pSrc,
@@ -107,6 +255,8 @@ fbGlyphs(CARD8 op,
     pixman_image_t *srcImage, *dstImage;
     int srcXoff, srcYoff, dstXoff, dstYoff;
     GlyphPtr glyph;
+    FbGlyphsDisjointRec disjoint = { .disjoint = TRUE };
+    pixman_format_code_t format;
     int n_glyphs;
     int x, y;
     int i, n;
@@ -169,6 +319,9 @@ fbGlyphs(CARD8 op,
 	    pglyphs[i].glyph = g;
 	    i++;
 
+	    if (!maskFormat)
+		fbGlyphsCheckDisjoint(&disjoint, glyph, x, y);
+
 	next:
             x += glyph->info.xOff;
             y += glyph->info.yOff;
@@ -182,11 +335,13 @@ fbGlyphs(CARD8 op,
     if (!(dstImage = image_from_pict(pDst, TRUE, &dstXoff, &dstYoff)))
 	goto out_free_src;
 
-    if (maskFormat) {
-	pixman_format_code_t format;
-	pixman_box32_t extents;
-
+    if (maskFormat)
 	format = maskFormat->format | (maskFormat->depth << 24);
+    else
+	format = fbGlyphsBatchFormat(op, &disjoint, n_glyphs, pglyphs);
+
+    if (format) {
+	pixman_box32_t extents;
 
 	pixman_glyph_get_extents(glyphCache, n_glyphs, pglyphs, &extents);
 
@@ -25,9 +25,181 @@
 #endif
 
 #include <stdlib.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "fb.h"
 
+/*
+ * Pixmap memory is recycled through one free list per size class, so
+ * clients that create and free lots of short-lived pixmaps neither go
+ * through malloc() nor fault in fresh pages every time.  There are four
+ * classes per power of two, so at most a fifth of a block is wasted.
+ * Every block is a separate malloc() of exactly its class size, which
+ * keeps FreePixmap() valid for pooled pixmaps too; those just don't make
+ * it back into the pool.  The class is kept in a pixmap private, zero for
+ * pixmaps that did not come from the pool.
+ *
+ * PixmapPoolLimit bounds the bytes held in the free lists, and blocks of
+ * huge page size are advised to use huge pages with PixmapPoolHugePages.
+ */
+#define FB_POOL_MIN_SHIFT   8   /* 256 bytes */
+#define FB_POOL_MAX_SHIFT   22  /* 4MB */
+#define FB_POOL_STEPS       4   /* classes per power of two */
+#define FB_POOL_CLASSES     ((FB_POOL_MAX_SHIFT - FB_POOL_MIN_SHIFT) * \
+                             FB_POOL_STEPS + 1)
+#define FB_POOL_HUGE_SIZE   (2 << 20)
+
+typedef struct _FbPoolBlock {
+    struct _FbPoolBlock *next;
+} FbPoolBlockRec, *FbPoolBlockPtr;
+
+static FbPoolBlockPtr fbPoolFree[FB_POOL_CLASSES];
+static FbPixmapPoolStatsRec fbPoolStats;
+
+#define fbGetPixmapPoolKey(pScreen) \
+    (&fbGetScreenPrivate(pScreen)->pixmapPrivateKeyRec)
+
+static size_t
+fbPoolClassSize(int class)
+{
+    size_t base = (size_t) 1 << (FB_POOL_MIN_SHIFT + class / FB_POOL_STEPS);
+
+    return base + (class % FB_POOL_STEPS) * (base / FB_POOL_STEPS);
+}
+
+/* the smallest class that holds size bytes, -1 if none does */
+static int
+fbPoolClass(size_t size)
+{
+    size_t base;
+    int shift;
+
+    if (size <= ((size_t) 1 << FB_POOL_MIN_SHIFT))
+        return 0;
+    if (size > ((size_t) 1 << FB_POOL_MAX_SHIFT))
+        return -1;
+
+    for (shift = FB_POOL_MIN_SHIFT; ((size - 1) >> shift) > 1; shift++);
+    base = (size_t) 1 << shift;
+
+    return (shift - FB_POOL_MIN_SHIFT) * FB_POOL_STEPS +
+        ((size - base) * FB_POOL_STEPS + base - 1) / base;
+}
+
+static PixmapPtr
+fbAllocatePixmap(ScreenPtr pScreen, size_t datasize)
+{
+    PixmapPtr pPixmap;
+    FbPoolBlockPtr block;
+    size_t size;
+    int class = -1;
+
+    if (pScreen->totalPixmapSize > ((size_t) -1) - datasize)
+        return NullPixmap;
+
+    if (PixmapPoolLimit)
+        class = fbPoolClass(pScreen->totalPixmapSize + datasize);
+    if (class < 0) {
+        fbPoolStats.unpooled++;
+        return AllocatePixmap(pScreen, datasize);
+    }
+
+    size = fbPoolClassSize(class);
+    if ((block = fbPoolFree[class])) {
+        fbPoolFree[class] = block->next;
+        fbPoolStats.pooled--;
+        fbPoolStats.pooled_bytes -= size;
+        fbPoolStats.hits++;
+    }
+    else {
+        if (!(block = malloc(size)))
+            return NullPixmap;
+#if defined(HAVE_MMAP) && defined(MADV_HUGEPAGE)
+        if (PixmapPoolHugePages && size >= FB_POOL_HUGE_SIZE) {
+            uintptr_t start = ((uintptr_t) block + FB_POOL_HUGE_SIZE - 1) &
+                ~((uintptr_t) FB_POOL_HUGE_SIZE - 1);
+            uintptr_t end = ((uintptr_t) block + size) &
+                ~((uintptr_t) FB_POOL_HUGE_SIZE - 1);
+
+            if (start < end)
+                madvise((void *) start, end - start, MADV_HUGEPAGE);
+        }
+#endif
+        fbPoolStats.misses++;
+    }
+
+    pPixmap = (PixmapPtr) block;
+    dixInitScreenPrivates(pScreen, pPixmap, pPixmap + 1, PRIVATE_PIXMAP);
+    dixSetPrivate(&pPixmap->devPrivates, fbGetPixmapPoolKey(pScreen),
+                  (void *) (intptr_t) (class + 1));
+    return pPixmap;
+}
+
+static void
+fbFreePixmap(PixmapPtr pPixmap)
+{
+    ScreenPtr pScreen = pPixmap->drawable.pScreen;
+    FbPoolBlockPtr block;
+    size_t size;
+    int class;
+
+    class = (intptr_t) dixLookupPrivate(&pPixmap->devPrivates,
+                                        fbGetPixmapPoolKey(pScreen)) - 1;
+    if (class < 0) {
+        FreePixmap(pPixmap);
+        return;
+    }
+
+    size = fbPoolClassSize(class);
+    if (fbPoolStats.pooled_bytes + size > PixmapPoolLimit) {
+        fbPoolStats.released++;
+        FreePixmap(pPixmap);
+        return;
+    }
+
+    dixFiniPrivates(pPixmap, PRIVATE_PIXMAP);
+    block = (FbPoolBlockPtr) pPixmap;
+    block->next = fbPoolFree[class];
+    fbPoolFree[class] = block;
+    fbPoolStats.pooled++;
+    fbPoolStats.pooled_bytes += size;
+}
+
+void
+fbGetPixmapPoolStats(FbPixmapPoolStatsPtr stats)
+{
+    *stats = fbPoolStats;
+}
+
+/* give the pooled memory back, on server reset */
+void
+fbFlushPixmapPool(void)
+{
+    FbPoolBlockPtr block;
+    unsigned long allocs;
+    int class;
+
+    allocs = fbPoolStats.hits + fbPoolStats.misses;
+    if (allocs)
+        LogMessageVerb(X_INFO, 3,
+                       "fb: pixmap pool: %lu of %lu allocations reused "
+                       "(%lu%%), %lu unpooled, %lu released, %lu bytes "
+                       "pooled\n", fbPoolStats.hits, allocs,
+                       fbPoolStats.hits * 100 / allocs, fbPoolStats.unpooled,
+                       fbPoolStats.released, fbPoolStats.pooled_bytes);
+
+    for (class = 0; class < FB_POOL_CLASSES; class++) {
+        while ((block = fbPoolFree[class])) {
+            fbPoolFree[class] = block->next;
+            free(block);
+        }
+    }
+    fbPoolStats.pooled = 0;
+    fbPoolStats.pooled_bytes = 0;
+}
+
 PixmapPtr
 fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
                unsigned usage_hint)
@@ -51,7 +223,7 @@ fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
 #ifdef FB_DEBUG
     datasize += 2 * paddedWidth;
 #endif
-    pPixmap = AllocatePixmap(pScreen, datasize);
+    pPixmap = fbAllocatePixmap(pScreen, datasize);
     if (!pPixmap)
         return NullPixmap;
     pPixmap->drawable.type = DRAWABLE_PIXMAP;
@@ -91,7 +263,7 @@ fbDestroyPixmap(PixmapPtr pPixmap)
 {
     if (--pPixmap->refcnt)
         return TRUE;
-    FreePixmap(pPixmap);
+    fbFreePixmap(pPixmap);
     return TRUE;
 }
 
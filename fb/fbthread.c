@@ -0,0 +1,179 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "fb.h"
+#include "fbthread.h"
+#include "picture.h"
+
+#ifdef FB_THREADS
+
+#include <pthread.h>
+#include <signal.h>
+
+/* fewest rows given to one band */
+#define FB_THREAD_MIN_ROWS	16
+#define FB_THREAD_MAX		64
+
+typedef struct _fbThreadJob {
+    FbThreadRowsProc proc;
+    void *closure;
+    int height;
+    int nbands;
+    int next;                   /* first band not yet claimed */
+    int pending;                /* bands not yet finished */
+} FbThreadJobRec, *FbThreadJobPtr;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    FbThreadJobPtr job;
+    int nthreads;               /* workers, not counting the main thread */
+} fbThreads = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+fbThreadBand(FbThreadJobPtr job, int band)
+{
+    (*job->proc) (job->closure,
+                  job->height * band / job->nbands,
+                  job->height * (band + 1) / job->nbands);
+}
+
+/*
+ * Claim and run bands of job until none are left.  Called, and returns,
+ * with fbThreads.lock held; a claimed band keeps job->pending above zero,
+ * which keeps the job alive until it is finished.
+ */
+static void
+fbThreadBands(FbThreadJobPtr job)
+{
+    int band;
+
+    while (job->next < job->nbands) {
+        band = job->next++;
+        pthread_mutex_unlock(&fbThreads.lock);
+
+        fbThreadBand(job, band);
+
+        pthread_mutex_lock(&fbThreads.lock);
+        if (--job->pending == 0)
+            pthread_cond_signal(&fbThreads.done);
+    }
+}
+
+static void *
+fbThreadMain(void *arg)
+{
+    FbThreadJobPtr job;
+
+    pthread_mutex_lock(&fbThreads.lock);
+    for (;;) {
+        while (!(job = fbThreads.job) || job->next >= job->nbands)
+            pthread_cond_wait(&fbThreads.work, &fbThreads.lock);
+        fbThreadBands(job);
+    }
+    return NULL;
+}
+
+/* Start the workers on first use; returns how many are running */
+static int
+fbThreadsStart(void)
+{
+    static Bool started;
+    sigset_t set, old;
+    pthread_t thread;
+    int want = min(PictureRenderThreads, FB_THREAD_MAX) - 1;
+
+    if (started)
+        return fbThreads.nthreads;
+    started = TRUE;
+
+    /* leave signal handling to the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    while (fbThreads.nthreads < want &&
+           pthread_create(&thread, NULL, fbThreadMain, NULL) == 0) {
+        pthread_detach(thread);
+        fbThreads.nthreads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (fbThreads.nthreads < want)
+        LogMessage(X_WARNING, "fb: started %d of %d render threads\n",
+                   fbThreads.nthreads, want);
+    return fbThreads.nthreads;
+}
+
+/*
+ * Split rows [0, height) into bands and run proc on each, using the
+ * worker threads and the calling thread.  With firstAlone, the first
+ * band runs before any other starts, for operations whose first call
+ * sets up state the others share.  Returns FALSE without calling proc
+ * when threads are disabled or height is too small to split.
+ */
+Bool
+fbThreadRows(FbThreadRowsProc proc, void *closure, int height,
+             Bool firstAlone)
+{
+    FbThreadJobRec job;
+    int nthreads;
+
+    if (PictureRenderThreads <= 1 || height < 2 * FB_THREAD_MIN_ROWS)
+        return FALSE;
+
+    nthreads = fbThreadsStart();
+    if (!nthreads)
+        return FALSE;
+
+    job.proc = proc;
+    job.closure = closure;
+    job.height = height;
+    job.nbands = min((nthreads + 1) * 2, height / FB_THREAD_MIN_ROWS);
+    job.next = 0;
+    job.pending = job.nbands;
+
+    if (firstAlone) {
+        job.next = 1;
+        job.pending--;
+        fbThreadBand(&job, 0);
+    }
+
+    pthread_mutex_lock(&fbThreads.lock);
+    fbThreads.job = &job;
+    pthread_cond_broadcast(&fbThreads.work);
+    fbThreadBands(&job);
+    while (job.pending)
+        pthread_cond_wait(&fbThreads.done, &fbThreads.lock);
+    fbThreads.job = NULL;
+    pthread_mutex_unlock(&fbThreads.lock);
+
+    return TRUE;
+}
+
+#endif
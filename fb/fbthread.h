@@ -0,0 +1,49 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _FBTHREAD_H_
+#define _FBTHREAD_H_
+
+/*
+ * Large operations can be split into bands of rows and run on a pool of
+ * worker threads, see -renderthreads.  Threads are only available when
+ * the server is built with pthreads, and never with the access wrappers,
+ * whose callbacks into the driver are not expected to be reentrant.
+ */
+#if INPUTTHREAD && !defined(FB_ACCESS_WRAPPER)
+#define FB_THREADS 1
+#endif
+
+#ifdef FB_THREADS
+
+/* below this many pixels an operation is done inline */
+#define FB_THREAD_MIN_PIXELS	(256 * 256)
+
+/* Called for rows [y1, y2) of an operation, possibly on another thread */
+typedef void (*FbThreadRowsProc) (void *closure, int y1, int y2);
+
+extern Bool
+fbThreadRows(FbThreadRowsProc proc, void *closure, int height,
+             Bool firstAlone);
+
+#endif
+
+#endif                          /* _FBTHREAD_H_ */
@@ -48,10 +48,12 @@
 #define fbFillRegionSolid wfbFillRegionSolid
 #define fbFillSpans wfbFillSpans
 #define fbFixCoordModePrevious wfbFixCoordModePrevious
+#define fbFlushPixmapPool wfbFlushPixmapPool
 #define fbGCFuncs wfbGCFuncs
 #define fbGCOps wfbGCOps
 #define fbGeneration wfbGeneration
 #define fbGetImage wfbGetImage
+#define fbGetPixmapPoolStats wfbGetPixmapPoolStats
 #define fbGetScreenPrivateKey wfbGetScreenPrivateKey
 #define fbGetSpans wfbGetSpans
 #define _fbGetWindowPixmap _wfbGetWindowPixmap
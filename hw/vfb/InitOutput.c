@@ -46,6 +46,7 @@ from The Open Group.
 #include "input.h"
 #include "mipointer.h"
 #include "micmap.h"
+#include "damage.h"
 #include <sys/types.h>
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
@@ -63,6 +64,12 @@ from The Open Group.
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #endif                          /* HAS_SHM */
+#ifdef HAVE_STDATOMIC_H
+#include <stdatomic.h>
+#define vfbDamageLogFence() atomic_thread_fence(memory_order_release)
+#else
+#define vfbDamageLogFence() do { } while (0)    /* -damagelog is refused */
+#endif
 #include "dix.h"
 #include "miline.h"
 #include "glx_extinit.h"
@@ -76,6 +83,41 @@ from The Open Group.
 #define VFB_DEFAULT_LINEBIAS      0
 #define XWD_WINDOW_NAME_LEN      60
 
+/*
+ * With -damagelog, a shared framebuffer is followed by this record, at the
+ * first 8 byte boundary after the image, in native byte order.  Every time
+ * the server is about to block, the boxes damaged since the last time are
+ * appended to the ring and frame is incremented, so a reader can copy just
+ * the boxes between the head it saw last and the current one.
+ *
+ * The counters are 32 bits so that they are read in one piece everywhere,
+ * and wrap; VFB_DAMAGE_LOG_SIZE divides 2^32, so box n stays in the same
+ * slot across the wrap.  The writer raises writing over the slots it is
+ * about to fill before filling them, and raises head after, with a fence
+ * between each step.  A reader loads head, fences, copies the boxes from
+ * the head it saw last, fences and loads writing: if writing is more than
+ * VFB_DAMAGE_LOG_SIZE past the last head, some of the copied boxes may have
+ * been overwritten, as they have if head itself is that far ahead, and the
+ * reader has to copy the whole screen instead.
+ */
+#define VFB_DAMAGE_LOG_MAGIC     0x44627658     /* "XvbD" */
+#define VFB_DAMAGE_LOG_VERSION   2
+#define VFB_DAMAGE_LOG_SIZE      1024
+
+typedef struct {
+    INT16 x1, y1, x2, y2;
+} vfbDamageBox;
+
+typedef struct {
+    CARD32 magic;
+    CARD32 version;
+    CARD32 size;                /* boxes in the ring */
+    volatile CARD32 frame;      /* batches of boxes written */
+    volatile CARD32 writing;    /* boxes written or being written */
+    volatile CARD32 head;       /* boxes written, box n is in boxes[n % size] */
+    vfbDamageBox boxes[VFB_DAMAGE_LOG_SIZE];
+} vfbDamageLogRec, *vfbDamageLogPtr;
+
 typedef struct {
     int width;
     int paddedBytesWidth;
@@ -92,6 +134,10 @@ typedef struct {
     Pixel whitePixel;
     unsigned int lineBias;
     CloseScreenProcPtr closeScreen;
+    CreateScreenResourcesProcPtr createScreenResources;
+    ScreenBlockHandlerProcPtr blockHandler;
+    vfbDamageLogPtr pDamageLog;
+    DamagePtr pDamage;
 
 #ifdef HAVE_MMAP
     int mmap_fd;
@@ -124,6 +170,7 @@ typedef enum { NORMAL_MEMORY_FB, SHARED_MEMORY_FB, MMAPPED_FILE_FB } fbMemType;
 static fbMemType fbmemtype = NORMAL_MEMORY_FB;
 static char needswap = 0;
 static Bool Render = TRUE;
+static Bool vfbDamageLog = FALSE;
 
 #define swapcopy16(_dst, _src) \
     if (needswap) { CARD16 _s = _src; cpswaps(_s, _dst); } \
@@ -251,6 +298,7 @@ ddxUseMsg(void)
 #ifdef HAS_SHM
     ErrorF("-shmem                 put framebuffers in shared memory\n");
 #endif
+    ErrorF("-damagelog             log damaged boxes after shared framebuffers\n");
 }
 
 int
@@ -378,6 +426,15 @@ ddxProcessArgument(int argc, char *argv[], int i)
     }
 #endif
 
+    if (strcmp(argv[i], "-damagelog") == 0) {   /* -damagelog */
+#ifdef HAVE_STDATOMIC_H
+        vfbDamageLog = TRUE;
+#else
+        ErrorF("-damagelog is not supported on this platform\n");
+#endif
+        return 1;
+    }
+
     return 0;
 }
 
@@ -577,6 +634,8 @@ vfbAllocateSharedMemoryFramebuffer(vfbScreenInfoPtr pvfb)
 static char *
 vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
 {
+    int damageLogOffset = 0;
+
     if (pvfb->pfbMemory)
         return pvfb->pfbMemory; /* already done */
 
@@ -604,6 +663,13 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
     pvfb->sizeInBytes += SIZEOF(XWDheader) + XWD_WINDOW_NAME_LEN +
         pvfb->ncolors * SIZEOF(XWDColor);
 
+    /* and the damage log, if anybody else can see the framebuffer */
+
+    if (vfbDamageLog && fbmemtype != NORMAL_MEMORY_FB) {
+        damageLogOffset = (pvfb->sizeInBytes + 7) & ~7;
+        pvfb->sizeInBytes = damageLogOffset + sizeof(vfbDamageLogRec);
+    }
+
     pvfb->pXWDHeader = NULL;
     switch (fbmemtype) {
 #ifdef HAVE_MMAP
@@ -635,6 +701,15 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
                                        XWD_WINDOW_NAME_LEN);
         pvfb->pfbMemory = (char *) (pvfb->pXWDCmap + pvfb->ncolors);
 
+        if (damageLogOffset) {
+            pvfb->pDamageLog = (vfbDamageLogPtr) ((char *) pvfb->pXWDHeader +
+                                                  damageLogOffset);
+            memset(pvfb->pDamageLog, 0, sizeof(vfbDamageLogRec));
+            pvfb->pDamageLog->magic = VFB_DAMAGE_LOG_MAGIC;
+            pvfb->pDamageLog->version = VFB_DAMAGE_LOG_VERSION;
+            pvfb->pDamageLog->size = VFB_DAMAGE_LOG_SIZE;
+        }
+
         return pvfb->pfbMemory;
     }
     else
@@ -722,6 +797,85 @@ static miPointerScreenFuncRec vfbPointerCursorFuncs = {
     miPointerWarpCursor
 };
 
+/* append the boxes damaged since the last call to the damage log */
+static void
+vfbFlushDamageLog(vfbScreenInfoPtr pvfb)
+{
+    vfbDamageLogPtr pLog = pvfb->pDamageLog;
+    RegionPtr pRegion = DamageRegion(pvfb->pDamage);
+    BoxPtr pBox;
+    CARD32 head;
+    int nbox, i;
+
+    if (!RegionNotEmpty(pRegion))
+        return;
+
+    nbox = RegionNumRects(pRegion);
+    pBox = RegionRects(pRegion);
+    if (nbox > VFB_DAMAGE_LOG_SIZE) {
+        nbox = 1;
+        pBox = RegionExtents(pRegion);
+    }
+
+    head = pLog->head;
+    pLog->writing = head + nbox;
+    /* readers must see writing move before any of the boxes change */
+    vfbDamageLogFence();
+    for (i = 0; i < nbox; i++, pBox++) {
+        vfbDamageBox *pLogBox = &pLog->boxes[(head + i) % VFB_DAMAGE_LOG_SIZE];
+
+        pLogBox->x1 = pBox->x1;
+        pLogBox->y1 = pBox->y1;
+        pLogBox->x2 = pBox->x2;
+        pLogBox->y2 = pBox->y2;
+    }
+
+    /* and must not see the new head before the boxes */
+    vfbDamageLogFence();
+    pLog->head = head + nbox;
+    pLog->frame++;
+
+    DamageEmpty(pvfb->pDamage);
+}
+
+static void
+vfbDamageLogBlockHandler(ScreenPtr pScreen, void *timeout)
+{
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+
+    /* let the cursor and everything else finish drawing first */
+    pScreen->BlockHandler = pvfb->blockHandler;
+    (*pScreen->BlockHandler) (pScreen, timeout);
+    pvfb->blockHandler = pScreen->BlockHandler;
+    pScreen->BlockHandler = vfbDamageLogBlockHandler;
+
+    if (pvfb->pDamage)
+        vfbFlushDamageLog(pvfb);
+}
+
+static Bool
+vfbCreateScreenResources(ScreenPtr pScreen)
+{
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    Bool ret;
+
+    pScreen->CreateScreenResources = pvfb->createScreenResources;
+    ret = (*pScreen->CreateScreenResources) (pScreen);
+    pScreen->CreateScreenResources = vfbCreateScreenResources;
+    if (!ret)
+        return FALSE;
+
+    pvfb->pDamage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+                                 pScreen, NULL);
+    if (!pvfb->pDamage)
+        return FALSE;
+
+    /* the screen pixmap owns it from now on */
+    DamageRegister(&(*pScreen->GetScreenPixmap) (pScreen)->drawable,
+                   pvfb->pDamage);
+    return TRUE;
+}
+
 static Bool
 vfbCloseScreen(ScreenPtr pScreen)
 {
@@ -729,6 +883,9 @@ vfbCloseScreen(ScreenPtr pScreen)
 
     pScreen->CloseScreen = pvfb->closeScreen;
 
+    /* destroyed along with the screen pixmap below */
+    pvfb->pDamage = NULL;
+
     /*
      * fb overwrites miCloseScreen, so do this here
      */
@@ -953,6 +1110,16 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     pvfb->closeScreen = pScreen->CloseScreen;
     pScreen->CloseScreen = vfbCloseScreen;
 
+    if (ret && pvfb->pDamageLog) {
+        if (!DamageSetup(pScreen))
+            return FALSE;
+
+        pvfb->createScreenResources = pScreen->CreateScreenResources;
+        pScreen->CreateScreenResources = vfbCreateScreenResources;
+        pvfb->blockHandler = pScreen->BlockHandler;
+        pScreen->BlockHandler = vfbDamageLogBlockHandler;
+    }
+
     return ret;
 
 }                               /* end vfbScreenInit */
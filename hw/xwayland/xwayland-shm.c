@@ -40,10 +40,50 @@
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * SHM pixmaps are carved out of a few large shared memory files, each
+ * wrapped in a single wl_shm_pool, rather than getting a file, a mapping
+ * and a pool of their own. Pixmaps bigger than a quarter of a pool get a
+ * dedicated pool sized to fit.
+ *
+ * The compositor reads a buffer from the time it is attached until it
+ * sends wl_buffer.release, so a pixmap destroyed in between keeps its
+ * buffer and its range until then; otherwise the next pixmap carved out
+ * of the same range would show up in the surface.
+ */
+#define XWL_SHM_POOL_SIZE       (16 * 1024 * 1024)
+#define XWL_SHM_POOL_ALIGN      64
+
+struct xwl_shm_range {
+    size_t offset;
+    size_t size;
+};
+
+struct xwl_shm_pool {
+    struct xwl_screen *xwl_screen;      /* NULL once the screen has closed */
+    struct xorg_list link;
+    struct wl_shm_pool *pool;
+    int fd;
+    void *data;
+    size_t size;
+    int num_pixmaps;            /* including destroyed ones not released */
+    Bool dedicated;
+    struct xorg_list destroyed; /* destroyed pixmaps still busy */
+
+    /* free ranges, sorted by offset and never adjacent */
+    struct xwl_shm_range *free;
+    int num_free;
+    int size_free;
+};
+
 struct xwl_pixmap {
     struct wl_buffer *buffer;
     void *data;
     size_t size;
+    struct xwl_shm_pool *pool;
+    size_t offset;
+    Bool busy;                  /* attached and not released yet */
+    struct xorg_list link;      /* in pool->destroyed */
 };
 
 #ifndef HAVE_MKOSTEMP
@@ -172,6 +212,323 @@ os_create_anonymous_file(off_t size)
     return fd;
 }
 
+/*
+ * Create the backing file for a pool. memfd_create() keeps it off the
+ * file system entirely, and sealing it against shrinking means the
+ * compositor can't make us fault by truncating it. The file is left
+ * sparse: ranges are only backed as pixmaps are carved out of them.
+ */
+static int
+xwl_shm_create_fd(size_t size)
+{
+#ifdef HAVE_MEMFD_CREATE
+    int fd;
+    int ret;
+
+    fd = memfd_create("xwayland-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        do {
+            ret = ftruncate(fd, size);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret < 0) {
+            close(fd);
+            return -1;
+        }
+
+#ifdef F_ADD_SEALS
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+#endif
+        return os_move_fd(fd);
+    }
+#endif
+
+    return os_create_anonymous_file(size);
+}
+
+static struct xwl_shm_pool *
+xwl_shm_pool_create(struct xwl_screen *xwl_screen, size_t size,
+                    Bool dedicated)
+{
+    struct xwl_shm_pool *pool;
+    int fd;
+
+    pool = calloc(1, sizeof *pool);
+    if (pool == NULL)
+        return NULL;
+
+    fd = xwl_shm_create_fd(size);
+    if (fd < 0)
+        goto err_free_pool;
+
+    pool->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pool->data == MAP_FAILED)
+        goto err_close_fd;
+
+    if (!dedicated) {
+        pool->free = malloc(sizeof *pool->free);
+        if (pool->free == NULL)
+            goto err_munmap;
+        pool->free[0].offset = 0;
+        pool->free[0].size = size;
+        pool->num_free = 1;
+        pool->size_free = 1;
+    }
+
+    pool->pool = wl_shm_create_pool(xwl_screen->shm, fd, size);
+
+    pool->xwl_screen = xwl_screen;
+    pool->fd = fd;
+    pool->size = size;
+    pool->dedicated = dedicated;
+    xorg_list_init(&pool->destroyed);
+    xorg_list_append(&pool->link, &xwl_screen->shm_pools);
+
+    return pool;
+
+ err_munmap:
+    munmap(pool->data, size);
+ err_close_fd:
+    close(fd);
+ err_free_pool:
+    free(pool);
+
+    return NULL;
+}
+
+static void
+xwl_shm_pool_destroy(struct xwl_shm_pool *pool)
+{
+    if (pool->pool)
+        wl_shm_pool_destroy(pool->pool);
+    munmap(pool->data, pool->size);
+    close(pool->fd);
+    xorg_list_del(&pool->link);
+    free(pool->free);
+    free(pool);
+}
+
+/*
+ * First fit from the pool's free ranges. Returns FALSE if no range is
+ * big enough.
+ */
+static Bool
+xwl_shm_pool_alloc(struct xwl_shm_pool *pool, size_t size, size_t *offset)
+{
+    struct xwl_shm_range *range;
+    int i;
+
+    for (i = 0; i < pool->num_free; i++) {
+        range = &pool->free[i];
+        if (range->size < size)
+            continue;
+
+        *offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (range->size == 0) {
+            pool->num_free--;
+            memmove(range, range + 1,
+                    (pool->num_free - i) * sizeof *range);
+        }
+        pool->num_pixmaps++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Return a range to the pool, merging it with its neighbours. Freeing
+ * never fails: if the range can't be recorded it is simply lost until
+ * the pool is destroyed.
+ */
+static void
+xwl_shm_pool_free(struct xwl_shm_pool *pool, size_t offset, size_t size)
+{
+    struct xwl_shm_range *range;
+    Bool merge_prev, merge_next;
+    int i;
+
+    pool->num_pixmaps--;
+
+    for (i = 0; i < pool->num_free; i++)
+        if (pool->free[i].offset > offset)
+            break;
+
+    merge_prev = i > 0 &&
+        pool->free[i - 1].offset + pool->free[i - 1].size == offset;
+    merge_next = i < pool->num_free &&
+        offset + size == pool->free[i].offset;
+
+    if (merge_prev && merge_next) {
+        pool->free[i - 1].size += size + pool->free[i].size;
+        pool->num_free--;
+        memmove(&pool->free[i], &pool->free[i + 1],
+                (pool->num_free - i) * sizeof *range);
+    }
+    else if (merge_prev) {
+        pool->free[i - 1].size += size;
+    }
+    else if (merge_next) {
+        pool->free[i].offset = offset;
+        pool->free[i].size += size;
+    }
+    else {
+        if (pool->num_free == pool->size_free) {
+            int size_free = pool->size_free * 2;
+
+            range = reallocarray(pool->free, size_free, sizeof *range);
+            if (range == NULL)
+                return;
+            pool->free = range;
+            pool->size_free = size_free;
+        }
+        range = &pool->free[i];
+        memmove(range + 1, range, (pool->num_free - i) * sizeof *range);
+        range->offset = offset;
+        range->size = size;
+        pool->num_free++;
+    }
+}
+
+/*
+ * Back a range with pages before a pixmap gets it. Writing to a hole in
+ * the file allocates them, which on a full file system (or with strict
+ * overcommit, for memfd) raises SIGBUS instead of failing the
+ * allocation; see os_create_anonymous_file(). The range may have been
+ * punched out by MADV_REMOVE since it was last used.
+ */
+static Bool
+xwl_shm_pool_reserve(struct xwl_shm_pool *pool, size_t offset, size_t size)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+    int ret;
+
+    OsBlockSignals();
+    do {
+        ret = posix_fallocate(pool->fd, offset, size);
+    } while (ret == EINTR);
+    OsReleaseSignals();
+
+    return ret == 0;
+#else
+    return TRUE;
+#endif
+}
+
+static size_t
+xwl_shm_alloc_size(size_t size)
+{
+    if (size == 0)
+        return XWL_SHM_POOL_ALIGN;
+    return (size + XWL_SHM_POOL_ALIGN - 1) & ~(size_t) (XWL_SHM_POOL_ALIGN - 1);
+}
+
+static struct xwl_shm_pool *
+xwl_shm_alloc(struct xwl_screen *xwl_screen, size_t size, size_t *offset)
+{
+    struct xwl_shm_pool *pool;
+
+    size = xwl_shm_alloc_size(size);
+    if (size > XWL_SHM_POOL_SIZE / 4) {
+        pool = xwl_shm_pool_create(xwl_screen, size, TRUE);
+        if (pool && !xwl_shm_pool_reserve(pool, 0, size)) {
+            xwl_shm_pool_destroy(pool);
+            return NULL;
+        }
+        if (pool) {
+            pool->num_pixmaps = 1;
+            *offset = 0;
+        }
+        return pool;
+    }
+
+    xorg_list_for_each_entry(pool, &xwl_screen->shm_pools, link) {
+        if (!pool->dedicated && xwl_shm_pool_alloc(pool, size, offset))
+            goto reserve;
+    }
+
+    pool = xwl_shm_pool_create(xwl_screen, XWL_SHM_POOL_SIZE, FALSE);
+    if (pool && !xwl_shm_pool_alloc(pool, size, offset)) {
+        xwl_shm_pool_destroy(pool);
+        pool = NULL;
+    }
+    if (pool == NULL)
+        return NULL;
+
+ reserve:
+    if (!xwl_shm_pool_reserve(pool, *offset, size)) {
+        xwl_shm_pool_free(pool, *offset, size);
+        return NULL;
+    }
+
+    return pool;
+}
+
+static void
+xwl_shm_release(struct xwl_pixmap *xwl_pixmap)
+{
+    struct xwl_shm_pool *pool = xwl_pixmap->pool, *other;
+
+    if (pool->dedicated) {
+        xwl_shm_pool_destroy(pool);
+        return;
+    }
+
+    xwl_shm_pool_free(pool, xwl_pixmap->offset,
+                      xwl_shm_alloc_size(xwl_pixmap->size));
+    if (pool->num_pixmaps > 0)
+        return;
+
+    /* Screen gone, nobody will allocate from this pool again */
+    if (pool->xwl_screen == NULL) {
+        xwl_shm_pool_destroy(pool);
+        return;
+    }
+
+    /* Keep one empty pool around so create/destroy cycles stay cheap */
+    xorg_list_for_each_entry(other, &pool->xwl_screen->shm_pools, link) {
+        if (other != pool && !other->dedicated && other->num_pixmaps == 0) {
+            xwl_shm_pool_destroy(pool);
+            return;
+        }
+    }
+
+#if defined(MADV_REMOVE) && defined(HAVE_POSIX_FALLOCATE)
+    /* but give its pages back; they are reserved again as ranges are
+     * handed out */
+    madvise(pool->data, pool->size, MADV_REMOVE);
+#endif
+}
+
+static void
+xwl_shm_pixmap_free(struct xwl_pixmap *xwl_pixmap)
+{
+    if (xwl_pixmap->buffer)
+        wl_buffer_destroy(xwl_pixmap->buffer);
+    xwl_shm_release(xwl_pixmap);
+    free(xwl_pixmap);
+}
+
+static void
+xwl_shm_buffer_release(void *data, struct wl_buffer *buffer)
+{
+    struct xwl_pixmap *xwl_pixmap = data;
+
+    xwl_pixmap->busy = FALSE;
+
+    /* The pixmap was destroyed while the compositor was reading it */
+    if (!xorg_list_is_empty(&xwl_pixmap->link)) {
+        xorg_list_del(&xwl_pixmap->link);
+        xwl_shm_pixmap_free(xwl_pixmap);
+    }
+}
+
+static const struct wl_buffer_listener xwl_shm_buffer_listener = {
+    xwl_shm_buffer_release
+};
+
 static uint32_t
 shm_format_for_depth(int depth)
 {
@@ -195,11 +552,9 @@ xwl_shm_create_pixmap(ScreenPtr screen,
 {
     struct xwl_screen *xwl_screen = xwl_screen_get(screen);
     struct xwl_pixmap *xwl_pixmap;
-    struct wl_shm_pool *pool;
     PixmapPtr pixmap;
     size_t size, stride;
     uint32_t format;
-    int fd;
 
     if (hint == CREATE_PIXMAP_USAGE_GLYPH_PICTURE ||
         (width == 0 && height == 0) || depth < 15)
@@ -216,38 +571,36 @@ xwl_shm_create_pixmap(ScreenPtr screen,
     stride = PixmapBytePad(width, depth);
     size = stride * height;
     xwl_pixmap->buffer = NULL;
+    xwl_pixmap->busy = FALSE;
+    xorg_list_init(&xwl_pixmap->link);
     xwl_pixmap->size = size;
-    fd = os_create_anonymous_file(size);
-    if (fd < 0)
+    xwl_pixmap->pool = xwl_shm_alloc(xwl_screen, size, &xwl_pixmap->offset);
+    if (xwl_pixmap->pool == NULL)
         goto err_free_xwl_pixmap;
 
-    xwl_pixmap->data = mmap(NULL, size, PROT_READ | PROT_WRITE,
-                                  MAP_SHARED, fd, 0);
-    if (xwl_pixmap->data == MAP_FAILED)
-        goto err_close_fd;
+    xwl_pixmap->data = (char *) xwl_pixmap->pool->data + xwl_pixmap->offset;
 
     if (!(*screen->ModifyPixmapHeader) (pixmap, width, height, depth,
                                         BitsPerPixel(depth),
                                         stride, xwl_pixmap->data))
-        goto err_munmap;
+        goto err_release;
 
     format = shm_format_for_depth(pixmap->drawable.depth);
-    pool = wl_shm_create_pool(xwl_screen->shm, fd, xwl_pixmap->size);
-    xwl_pixmap->buffer = wl_shm_pool_create_buffer(pool, 0,
+    xwl_pixmap->buffer = wl_shm_pool_create_buffer(xwl_pixmap->pool->pool,
+                                                   xwl_pixmap->offset,
                                                    pixmap->drawable.width,
                                                    pixmap->drawable.height,
                                                    pixmap->devKind, format);
-    wl_shm_pool_destroy(pool);
-    close(fd);
+    if (xwl_pixmap->buffer)
+        wl_buffer_add_listener(xwl_pixmap->buffer,
+                               &xwl_shm_buffer_listener, xwl_pixmap);
 
     xwl_pixmap_set_private(pixmap, xwl_pixmap);
 
     return pixmap;
 
- err_munmap:
-    munmap(xwl_pixmap->data, size);
- err_close_fd:
-    close(fd);
+ err_release:
+    xwl_shm_release(xwl_pixmap);
  err_free_xwl_pixmap:
     free(xwl_pixmap);
  err_destroy_pixmap:
@@ -262,19 +615,77 @@ xwl_shm_destroy_pixmap(PixmapPtr pixmap)
     struct xwl_pixmap *xwl_pixmap = xwl_pixmap_get(pixmap);
 
     if (xwl_pixmap && pixmap->refcnt == 1) {
-        if (xwl_pixmap->buffer)
-            wl_buffer_destroy(xwl_pixmap->buffer);
-        munmap(xwl_pixmap->data, xwl_pixmap->size);
-        free(xwl_pixmap);
+        if (xwl_pixmap->busy && xwl_pixmap->pool->xwl_screen)
+            xorg_list_append(&xwl_pixmap->link,
+                             &xwl_pixmap->pool->destroyed);
+        else
+            xwl_shm_pixmap_free(xwl_pixmap);
     }
 
     return fbDestroyPixmap(pixmap);
 }
 
+/*
+ * Called as the screen closes. Pixmaps still alive (the screen pixmap is
+ * freed after this, by fb) keep their pool mapped until they go; the
+ * rest are freed now, along with destroyed pixmaps whose release will
+ * not be waited for any more.
+ */
+void
+xwl_shm_release_pools(struct xwl_screen *xwl_screen)
+{
+    struct xwl_shm_pool *pool, *next;
+    struct xwl_pixmap *xwl_pixmap, *tmp;
+    struct xorg_list destroyed;
+    size_t mapped = 0;
+    int num_pools = 0, num_pixmaps = 0;
+
+    /* Freeing these may destroy their pool, so collect them first */
+    xorg_list_init(&destroyed);
+    xorg_list_for_each_entry(pool, &xwl_screen->shm_pools, link) {
+        xorg_list_for_each_entry_safe(xwl_pixmap, tmp,
+                                      &pool->destroyed, link) {
+            xorg_list_del(&xwl_pixmap->link);
+            xorg_list_append(&xwl_pixmap->link, &destroyed);
+        }
+    }
+    xorg_list_for_each_entry_safe(xwl_pixmap, tmp, &destroyed, link) {
+        xorg_list_del(&xwl_pixmap->link);
+        xwl_shm_pixmap_free(xwl_pixmap);
+    }
+
+    xorg_list_for_each_entry_safe(pool, next, &xwl_screen->shm_pools, link) {
+        num_pools++;
+        num_pixmaps += pool->num_pixmaps;
+        mapped += pool->size;
+
+        wl_shm_pool_destroy(pool->pool);
+        pool->pool = NULL;
+
+        if (pool->num_pixmaps == 0) {
+            xwl_shm_pool_destroy(pool);
+        }
+        else {
+            xorg_list_del(&pool->link);
+            xorg_list_init(&pool->link);
+            pool->xwl_screen = NULL;
+        }
+    }
+
+    LogMessageVerb(X_INFO, 3,
+                   "xwayland: %d SHM pools, %zu KiB mapped, "
+                   "%d pixmaps at close\n",
+                   num_pools, mapped / 1024, num_pixmaps);
+}
+
+/* The caller attaches the buffer, so it is busy until released */
 struct wl_buffer *
 xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap)
 {
-    return xwl_pixmap_get(pixmap)->buffer;
+    struct xwl_pixmap *xwl_pixmap = xwl_pixmap_get(pixmap);
+
+    xwl_pixmap->busy = TRUE;
+    return xwl_pixmap->buffer;
 }
 
 Bool
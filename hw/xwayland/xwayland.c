@@ -251,6 +251,8 @@ xwl_close_screen(ScreenPtr screen)
 
     RemoveNotifyFd(xwl_screen->wayland_fd);
 
+    xwl_shm_release_pools(xwl_screen);
+
     wl_display_disconnect(xwl_screen->display);
 
     screen->CloseScreen = xwl_screen->CloseScreen;
@@ -1026,6 +1028,7 @@ xwl_screen_init(ScreenPtr pScreen, int argc, char **argv)
     xorg_list_init(&xwl_screen->output_list);
     xorg_list_init(&xwl_screen->seat_list);
     xorg_list_init(&xwl_screen->damage_window_list);
+    xorg_list_init(&xwl_screen->shm_pools);
     xwl_screen->depth = 24;
 
     xwl_screen->display = wl_display_connect(NULL);
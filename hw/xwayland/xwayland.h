@@ -82,6 +82,7 @@ struct xwl_screen {
     struct xorg_list output_list;
     struct xorg_list seat_list;
     struct xorg_list damage_window_list;
+    struct xorg_list shm_pools;
 
     int wayland_fd;
     struct wl_display *display;
@@ -410,6 +411,7 @@ Bool xwl_shm_create_screen_resources(ScreenPtr screen);
 PixmapPtr xwl_shm_create_pixmap(ScreenPtr screen, int width, int height,
                                 int depth, unsigned int hint);
 Bool xwl_shm_destroy_pixmap(PixmapPtr pixmap);
+void xwl_shm_release_pools(struct xwl_screen *xwl_screen);
 struct wl_buffer *xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap);
 
 
@@ -127,6 +127,22 @@ extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
 
 extern _X_EXPORT void ResetOsBuffers(void);
 
+/* connection buffer allocation counters, see os/io.c */
+typedef struct _OsBufferStats {
+    unsigned long input_allocated;      /* new input buffers */
+    unsigned long input_reused;         /* input buffers taken from the pool */
+    unsigned long input_freed;          /* input buffers not kept in the pool */
+    unsigned long input_grown;          /* input buffer reallocations */
+    unsigned long input_pooled;         /* input buffers currently pooled */
+    unsigned long output_allocated;
+    unsigned long output_reused;
+    unsigned long output_freed;
+    unsigned long output_grown;
+    unsigned long output_pooled;
+} OsBufferStatsRec, *OsBufferStatsPtr;
+
+extern _X_EXPORT void GetOsBufferStats(OsBufferStatsPtr /* stats */ );
+
 extern _X_EXPORT void InitConnectionLimits(void);
 
 extern _X_EXPORT void NotifyParentProcess(void);
@@ -112,6 +112,10 @@ extern _X_EXPORT PixmapPtr AllocatePixmap(ScreenPtr /*pScreen */ ,
 
 extern _X_EXPORT void FreePixmap(PixmapPtr /*pPixmap */ );
 
+/* limits for the pixmap memory pool of fb, see fb/fbpixmap.c */
+extern _X_EXPORT unsigned long PixmapPoolLimit;
+extern _X_EXPORT Bool PixmapPoolHugePages;
+
 extern _X_EXPORT PixmapPtr
 PixmapShareToSlave(PixmapPtr pixmap, ScreenPtr slave);
 
@@ -0,0 +1,60 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REQPROF_H
+#define REQPROF_H
+
+#include "misc.h"
+#include "dixstruct.h"
+
+/*
+ * Request profiling, enabled with -reqprof.  Dispatch() times every
+ * request and accumulates per-opcode counts, time and a log2 latency
+ * histogram, plus per-client totals.  The profile is written to the log
+ * on SIGUSR2 and when the server resets or exits.
+ *
+ * Other statistics can follow the profile on SIGUSR2 by adding themselves
+ * to RequestProfileDumpCallback.
+ */
+
+/* latency histogram buckets: [0, 1us), [1us, 2us), ... [2^22us, inf) */
+#define REQPROF_BUCKETS 24
+
+typedef struct _ReqProf {
+    CARD64 count;
+    CARD64 total;               /* usec */
+    CARD64 max;                 /* usec */
+    CARD32 hist[REQPROF_BUCKETS];
+} ReqProfRec, *ReqProfPtr;
+
+extern Bool RequestProfiling;
+extern volatile char RequestProfileDumpPending;
+extern CallbackListPtr RequestProfileDumpCallback;
+
+extern void RequestProfileInit(void);
+extern void RequestProfileRecord(ClientPtr client, CARD64 start);
+extern void RequestProfileDump(void);
+extern void RequestProfileReset(void);
+
+/* for tests: the counters of a given opcode, NULL if never seen */
+extern ReqProfPtr RequestProfileLookup(int major, int minor);
+
+#endif                          /* REQPROF_H */
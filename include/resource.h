@@ -265,10 +265,10 @@ extern _X_EXPORT RESTYPE TypeMask;
     @param id The resource ID to hash
     @param numBits The number of bits in the resulting hash. Must be >=0.
 
-    @note This function is really only for handling
-    INITHASHSIZE..MAXHASHSIZE bit hashes, but will handle any number
-    of bits by either masking numBits lower bits of the ID or by
-    providing at most MAXHASHSIZE hashes.
+    @note Hashes of up to 31 bits are supported.  The hash for numBits
+    is the low numBits of the hash for numBits + 1, so bucket b of a
+    table splits into buckets b and b + 2^numBits of a table twice its
+    size.
 */
 extern _X_EXPORT int HashResourceID(XID id,
                                     int numBits);
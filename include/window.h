@@ -99,6 +99,11 @@ extern _X_EXPORT void RegisterRealChildHeadProc(RealChildHeadProc proc);
 
 extern _X_EXPORT WindowPtr RealChildHead(WindowPtr /*pWin */ );
 
+extern _X_EXPORT WindowPtr *TopLevelWindowsAt(WindowPtr /*pRoot */ ,
+                                              int /*x */ ,
+                                              int /*y */ ,
+                                              int * /*nwin */ );
+
 extern _X_EXPORT WindowPtr CreateWindow(Window /*wid */ ,
                                         WindowPtr /*pParent */ ,
                                         int /*x */ ,
@@ -183,6 +183,8 @@ extern _X_EXPORT void miStepDash(int /*dist */ ,
 typedef struct _DeviceRec *DevicePtr;
 #endif
 
+extern _X_EXPORT Bool mieqCompressMotion;
+
 extern _X_EXPORT Bool mieqInit(void
     );
 
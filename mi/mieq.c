@@ -65,6 +65,8 @@ in this Software without prior written authorization from The Open Group.
 #define QUEUE_MAXIMUM_SIZE                4096
 #define QUEUE_DROP_BACKTRACE_FREQUENCY     100
 #define QUEUE_DROP_BACKTRACE_MAX            10
+#define QUEUE_DRAIN_BATCH                   16
+#define QUEUE_COMPRESS_TRACE                32
 
 #define EnqueueScreen(dev) dev->spriteInfo->sprite->pEnqueueScreen
 #define DequeueScreen(dev) dev->spriteInfo->sprite->pDequeueScreen
@@ -87,6 +89,15 @@ typedef struct _EventQueue {
 
 static EventQueueRec miEventQueue;
 
+Bool mieqCompressMotion = FALSE;
+
+/* An event copied out of the queue by mieqProcessInputEvents */
+typedef struct _DequeuedEvent {
+    InternalEvent event;
+    ScreenPtr pScreen;
+    DeviceIntPtr pDev;
+} DequeuedEventRec;
+
 static size_t
 mieqNumEnqueued(EventQueuePtr eventQueue)
 {
@@ -497,14 +508,94 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
     }
 }
 
-/* Call this from ProcessInputEvents(). */
+/*
+ * With -compressmotion, a motion event need not be delivered if a later
+ * motion event from the same device was dequeued in the same batch and
+ * supersedes it: only raw motion of that device lies between the two,
+ * the later event carries every valuator the earlier one does, and both
+ * positions are over the same window, so no crossing events are lost.
+ * The raw events are still delivered for every sample.
+ */
+static Bool
+mieqMotionSuperseded(DequeuedEventRec *batch, int i, int n)
+{
+    DeviceEvent *ev = &batch[i].event.device_event, *next;
+    DeviceIntPtr dev = batch[i].pDev;
+    WindowPtr trace[QUEUE_COMPRESS_TRACE], win;
+    SpritePtr sprite;
+    BoxPtr limits;
+    Bool same;
+    int j, v, good;
+
+    if (ev->type != ET_Motion || miEventQueue.handlers[ET_Motion] ||
+        !dev || !dev->spriteInfo || !(sprite = dev->spriteInfo->sprite))
+        return FALSE;
+
+    for (j = i + 1; j < n; j++) {
+        if (batch[j].pDev != dev)
+            return FALSE;
+        if (batch[j].event.any.type != ET_RawMotion)
+            break;
+    }
+    if (j == n || batch[j].event.any.type != ET_Motion)
+        return FALSE;
+
+    next = &batch[j].event.device_event;
+    if (batch[j].pScreen != batch[i].pScreen ||
+        next->deviceid != ev->deviceid || next->sourceid != ev->sourceid ||
+        next->flags != ev->flags || next->root != ev->root ||
+        memcmp(next->buttons, ev->buttons, sizeof(ev->buttons)) ||
+        memcmp(next->valuators.mode, ev->valuators.mode,
+               sizeof(ev->valuators.mode)))
+        return FALSE;
+    for (v = 0; v < MAX_VALUATORS; v++)
+        if (BitIsOn(ev->valuators.mask, v) &&
+            !BitIsOn(next->valuators.mask, v))
+            return FALSE;
+
+    /* CheckMotion() may move the hot spot, don't guess where it ends up */
+#ifdef PANORAMIX
+    if (!noPanoramiXExtension)
+        return FALSE;
+#endif
+    limits = &sprite->physLimits;
+    if (sprite->hotShape || !sprite->spriteTraceGood ||
+        sprite->spriteTrace[0]->drawable.id != ev->root ||
+        ev->root_x < limits->x1 || ev->root_x >= limits->x2 ||
+        ev->root_y < limits->y1 || ev->root_y >= limits->y2 ||
+        next->root_x < limits->x1 || next->root_x >= limits->x2 ||
+        next->root_y < limits->y1 || next->root_y >= limits->y2)
+        return FALSE;
+
+    /* look both positions up without disturbing the current sprite trace */
+    good = sprite->spriteTraceGood;
+    if (good > QUEUE_COMPRESS_TRACE)
+        return FALSE;
+    memcpy(trace, sprite->spriteTrace, good * sizeof(WindowPtr));
+    win = XYToWindow(sprite, ev->root_x, ev->root_y);
+    same = XYToWindow(sprite, next->root_x, next->root_y) == win;
+    memcpy(sprite->spriteTrace, trace, good * sizeof(WindowPtr));
+    sprite->spriteTraceGood = good;
+
+    return same;
+}
+
+/*
+ * Call this from ProcessInputEvents().
+ *
+ * Events are copied out of the queue QUEUE_DRAIN_BATCH at a time and
+ * processed with the input lock released, so the input thread contends
+ * with us for one short copy per batch instead of once per event.
+ */
 void
 mieqProcessInputEvents(void)
 {
     EventRec *e = NULL;
     ScreenPtr screen;
-    InternalEvent event;
+    InternalEvent *event;
+    DequeuedEventRec batch[QUEUE_DRAIN_BATCH];
     DeviceIntPtr dev = NULL, master = NULL;
+    int i, n;
     static Bool inProcessInputEvents = FALSE;
 
     input_lock();
@@ -526,37 +617,50 @@ mieqProcessInputEvents(void)
     }
 
     while (miEventQueue.head != miEventQueue.tail) {
-        e = &miEventQueue.events[miEventQueue.head];
+        for (n = 0; n < QUEUE_DRAIN_BATCH &&
+             miEventQueue.head != miEventQueue.tail; n++) {
+            e = &miEventQueue.events[miEventQueue.head];
 
-        event = *e->events;
-        dev = e->pDev;
-        screen = e->pScreen;
+            /* only the first length bytes of the slot were written */
+            memcpy(&batch[n].event, e->events, e->events->any.length);
+            batch[n].pDev = e->pDev;
+            batch[n].pScreen = e->pScreen;
 
-        miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
+            miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
+        }
 
         input_unlock();
 
-        master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
+        for (i = 0; i < n; i++) {
+            event = &batch[i].event;
+            dev = batch[i].pDev;
+            screen = batch[i].pScreen;
+
+            if (mieqCompressMotion && mieqMotionSuperseded(batch, i, n))
+                continue;
 
-        if (screenIsSaved == SCREEN_SAVER_ON)
-            dixSaveScreens(serverClient, SCREEN_SAVER_OFF, ScreenSaverReset);
+            master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
+
+            if (screenIsSaved == SCREEN_SAVER_ON)
+                dixSaveScreens(serverClient, SCREEN_SAVER_OFF, ScreenSaverReset);
 #ifdef DPMSExtension
-        else if (DPMSPowerLevel != DPMSModeOn)
-            SetScreenSaverTimer();
+            else if (DPMSPowerLevel != DPMSModeOn)
+                SetScreenSaverTimer();
 
-        if (DPMSPowerLevel != DPMSModeOn)
-            DPMSSet(serverClient, DPMSModeOn);
+            if (DPMSPowerLevel != DPMSModeOn)
+                DPMSSet(serverClient, DPMSModeOn);
 #endif
 
-        mieqProcessDeviceEvent(dev, &event, screen);
+            mieqProcessDeviceEvent(dev, event, screen);
 
-        /* Update the sprite now. Next event may be from different device. */
-        if (master &&
-            (event.any.type == ET_Motion ||
-             ((event.any.type == ET_TouchBegin ||
-               event.any.type == ET_TouchUpdate) &&
-              event.device_event.flags & TOUCH_POINTER_EMULATED)))
-            miPointerUpdateSprite(dev);
+            /* Update the sprite now. Next event may be from different device. */
+            if (master &&
+                (event->any.type == ET_Motion ||
+                 ((event->any.type == ET_TouchBegin ||
+                   event->any.type == ET_TouchUpdate) &&
+                  event->device_event.flags & TOUCH_POINTER_EMULATED)))
+                miPointerUpdateSprite(dev);
+        }
 
         input_lock();
     }
@@ -40,7 +40,8 @@ typedef union _Validate {
         DDXPointRec oldAbsCorner;       /* old window position */
         RegionPtr borderVisible;        /* visible region of border, */
         /* non-null when size changes */
-        Bool resized;           /* unclipped winSize has changed */
+        Bool resized;           /* unclipped winSize has changed, */
+        /* or the clip lists must be recomputed */
     } before;
     struct AfterValidate {
         RegionRec exposed;      /* exposed regions, absolute pos */
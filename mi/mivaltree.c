@@ -177,6 +177,35 @@ miShapedWindowIn(RegionPtr universe, RegionPtr bounding,
 				    HasBorder(w) && \
 				    (w)->backgroundState == ParentRelative)
 
+/*
+ * Finish validation of a subtree whose clip lists are still correct:
+ * nothing is exposed, and neither serial numbers nor ClipNotify change.
+ */
+static void
+miTreeUnchanged(WindowPtr pParent)
+{
+    WindowPtr pChild;
+
+    pChild = pParent;
+    while (1) {
+        if (pChild->valdata) {
+            if (pChild->valdata->before.borderVisible)
+                RegionDestroy(pChild->valdata->before.borderVisible);
+            RegionNull(&pChild->valdata->after.exposed);
+            RegionNull(&pChild->valdata->after.borderExposed);
+            if (pChild->firstChild) {
+                pChild = pChild->firstChild;
+                continue;
+            }
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+}
+
 /*
  *-----------------------------------------------------------------------
  * miComputeClips --
@@ -278,6 +307,20 @@ miComputeClips(WindowPtr pParent,
     dx = pParent->drawable.x - pParent->valdata->before.oldAbsCorner.x;
     dy = pParent->drawable.y - pParent->valdata->before.oldAbsCorner.y;
 
+    /*
+     * A window which has neither moved nor changed shape, and whose new
+     * borderClip is the old one, keeps the clip lists of its whole subtree:
+     * it was only marked because its extents overlapped the change.
+     */
+    if (!dx && !dy && oldVis == newVis && kind != VTBroken &&
+        !RegionBroken(&pParent->clipList) &&
+        !pParent->valdata->before.resized &&
+        !pParent->valdata->before.borderVisible &&
+        RegionEqual(universe, &pParent->borderClip)) {
+        miTreeUnchanged(pParent);
+        return;
+    }
+
     /*
      * avoid computations when dealing with simple operations
      */
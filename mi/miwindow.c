@@ -748,10 +748,18 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
 WindowPtr
 miSpriteTrace(SpritePtr pSprite, int x, int y)
 {
-    WindowPtr pWin;
+    WindowPtr pWin, *candidates = NULL;
     BoxRec box;
-
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
+    int n;
+
+    pWin = DeepestSpriteWin(pSprite);
+    /* the screen may index its top-level windows by position */
+    if (!pWin->parent)
+        candidates = TopLevelWindowsAt(pWin, x, y, &n);
+    if (candidates)
+        pWin = n ? *candidates : NullWindow;
+    else
+        pWin = pWin->firstChild;
     while (pWin) {
         if ((pWin->mapped) &&
             (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
@@ -782,7 +790,10 @@ miSpriteTrace(SpritePtr pSprite, int x, int y)
             }
             pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
             pWin = pWin->firstChild;
+            candidates = NULL;
         }
+        else if (candidates)
+            pWin = --n ? *++candidates : NullWindow;
         else
             pWin = pWin->nextSib;
     }
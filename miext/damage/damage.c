@@ -24,7 +24,9 @@
 #include <dix-config.h>
 #endif
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include    <X11/X.h>
 #include    "scrnintstr.h"
@@ -121,6 +123,143 @@ getDrawableDamageRef(DrawablePtr pDrawable)
     DamagePtr	*pPrev = (DamagePtr *) \
 	dixLookupPrivateAddr(&(pWindow)->devPrivates, damageWinPrivateKey)
 
+/*
+ * Merge one band of boxes into the previous output band when that saves
+ * rectangles at a cost of at most budget pixels of overdraw for each box
+ * saved.  The merged band spans both bands and their union of x spans.
+ */
+static Bool
+damageMergeBands(BoxPtr prev, int nprev, BoxPtr band, int nband,
+                 BoxPtr merged, int *nmerged, int64_t budget)
+{
+    int y1 = prev[0].y1, y2 = band[0].y2;
+    int64_t area = 0, waste;
+    int i = 0, j = 0, n = 0;
+
+    while (i < nprev || j < nband) {
+        BoxPtr next;
+
+        if (j == nband || (i < nprev && prev[i].x1 <= band[j].x1))
+            next = &prev[i++];
+        else
+            next = &band[j++];
+
+        if (n && next->x1 <= merged[n - 1].x2) {
+            if (next->x2 > merged[n - 1].x2)
+                merged[n - 1].x2 = next->x2;
+        }
+        else {
+            merged[n].x1 = next->x1;
+            merged[n].x2 = next->x2;
+            merged[n].y1 = y1;
+            merged[n].y2 = y2;
+            n++;
+        }
+    }
+
+    if (n >= nprev + nband)
+        return FALSE;
+
+    for (i = 0; i < n; i++)
+        area += (int64_t) (merged[i].x2 - merged[i].x1) * (y2 - y1);
+    waste = area;
+    for (i = 0; i < nprev; i++)
+        waste -= (int64_t) (prev[i].x2 - prev[i].x1) * (prev[i].y2 - prev[i].y1);
+    for (i = 0; i < nband; i++)
+        waste -= (int64_t) (band[i].x2 - band[i].x1) * (band[i].y2 - band[i].y1);
+
+    if (waste > budget * (nprev + nband - n))
+        return FALSE;
+    *nmerged = n;
+    return TRUE;
+}
+
+/*
+ * One simplification pass over the y-x banded boxes in, writing the result
+ * to out.  Boxes in a band are joined across gaps costing no more than
+ * budget pixels, then each band is merged into the one above it when
+ * damageMergeBands() finds that worthwhile.  Returns the number of boxes
+ * written, which are still y-x banded and non-overlapping.
+ */
+static int
+damageSimplifyPass(BoxPtr in, int n, BoxPtr out, BoxPtr band,
+                   BoxPtr merged, int64_t budget)
+{
+    int i = 0, nout = 0, prev = -1;
+
+    while (i < n) {
+        int y1 = in[i].y1, y2 = in[i].y2;
+        int nband = 0, nmerged;
+
+        for (; i < n && in[i].y1 == y1; i++) {
+            if (nband &&
+                (int64_t) (in[i].x1 - band[nband - 1].x2) * (y2 - y1) <= budget)
+                band[nband - 1].x2 = in[i].x2;
+            else
+                band[nband++] = in[i];
+        }
+
+        if (prev >= 0 &&
+            damageMergeBands(&out[prev], nout - prev, band, nband,
+                             merged, &nmerged, budget)) {
+            memcpy(&out[prev], merged, nmerged * sizeof(BoxRec));
+            nout = prev + nmerged;
+        }
+        else {
+            prev = nout;
+            memcpy(&out[nout], band, nband * sizeof(BoxRec));
+            nout += nband;
+        }
+    }
+    return nout;
+}
+
+/*
+ * Reduce pRegion to at most maxRects boxes by covering it with fewer,
+ * larger boxes.  rectCost is the number of pixels of overdraw one box is
+ * worth to the consumer; merges are tried at that price first, and the
+ * price is raised until the region is small enough.  The result always
+ * contains the original region and stays within its extents.
+ */
+static void
+damageSimplifyRegion(RegionPtr pRegion, int maxRects, int rectCost)
+{
+    BoxRec extents = *RegionExtents(pRegion);
+    int64_t area = (int64_t) (extents.x2 - extents.x1) *
+        (extents.y2 - extents.y1);
+    int64_t budget = rectCost > 0 ? rectCost : DAMAGE_RECT_COST;
+    BoxPtr scratch = NULL;
+    int n = RegionNumRects(pRegion);
+
+    if (maxRects > 1)
+        scratch = xallocarray(3 * n, sizeof(BoxRec));
+
+    while (scratch && n > maxRects && budget < area) {
+        n = damageSimplifyPass(RegionRects(pRegion), n, scratch,
+                               scratch + n, scratch + 2 * n, budget);
+        RegionUninit(pRegion);
+        if (!RegionInitBoxes(pRegion, scratch, n))
+            break;
+        n = RegionNumRects(pRegion);
+        budget *= 2;
+    }
+    free(scratch);
+
+    if (!scratch || n > maxRects || !RegionNotEmpty(pRegion)) {
+        RegionUninit(pRegion);
+        RegionInit(pRegion, &extents, 1);
+    }
+}
+
+static Bool
+damageLimitRegion(DamagePtr pDamage, RegionPtr pRegion)
+{
+    if (!pDamage->maxRects || RegionNumRects(pRegion) <= pDamage->maxRects)
+        return FALSE;
+    damageSimplifyRegion(pRegion, pDamage->maxRects, pDamage->rectCost);
+    return TRUE;
+}
+
 #if DAMAGE_DEBUG_ENABLE
 static void
 _damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
@@ -256,16 +395,20 @@ damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
             RegionTranslate(pDamageRegion, -draw_x, -draw_y);
 
         /* Store damage region if needed after submission. */
-        if (pDamage->reportAfter)
+        if (pDamage->reportAfter) {
             RegionUnion(&pDamage->pendingDamage,
                         &pDamage->pendingDamage, pDamageRegion);
+            damageLimitRegion(pDamage, &pDamage->pendingDamage);
+        }
 
         /* Report damage now, if desired. */
         if (!pDamage->reportAfter) {
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, pDamageRegion);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+                damageLimitRegion(pDamage, &pDamage->damage);
+            }
         }
 
         /*
@@ -292,9 +435,11 @@ damageRegionProcessPending(DrawablePtr pDrawable)
             /* It's possible that there is only interest in postRendering reporting. */
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, &pDamage->pendingDamage);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage,
                             &pDamage->pendingDamage);
+                damageLimitRegion(pDamage, &pDamage->damage);
+            }
         }
 
         if (pDamage->reportAfter)
@@ -1710,6 +1855,8 @@ DamageCreate(DamageReportFunc damageReport,
     pDamage->isWindow = FALSE;
     pDamage->pDrawable = 0;
     pDamage->reportAfter = FALSE;
+    pDamage->maxRects = 0;
+    pDamage->rectCost = 0;
 
     pDamage->damageReport = damageReport;
     pDamage->damageDestroy = damageDestroy;
@@ -1903,6 +2050,21 @@ DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter)
     pDamage->reportAfter = reportAfter;
 }
 
+/*
+ * Keep the accumulated damage of pDamage under maxRects boxes by merging
+ * nearby boxes, trading rectCost pixels of extra area for each box saved
+ * (0 selects DAMAGE_RECT_COST).  The damage then covers more than was
+ * actually drawn, but consumers walking it have less to do.  A maxRects
+ * of 0 turns the limit off.
+ */
+void
+DamageSetRectLimit(DamagePtr pDamage, int maxRects, int rectCost)
+{
+    pDamage->maxRects = max(maxRects, 0);
+    pDamage->rectCost = rectCost;
+    damageLimitRegion(pDamage, &pDamage->damage);
+}
+
 DamageScreenFuncsPtr
 DamageGetScreenFuncs(ScreenPtr pScreen)
 {
@@ -1920,13 +2082,26 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     switch (pDamage->damageLevel) {
     case DamageReportRawRegion:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         (*pDamage->damageReport) (pDamage, pDamageRegion, pDamage->closure);
         break;
     case DamageReportDeltaRegion:
         RegionNull(&tmpRegion);
         RegionSubtract(&tmpRegion, pDamageRegion, &pDamage->damage);
         if (RegionNotEmpty(&tmpRegion)) {
+            RegionRec oldRegion;
+
+            /*
+             * Simplifying may grow the damage by more than the new
+             * region; report all of the growth so later deltas add up.
+             */
+            RegionNull(&oldRegion);
+            if (pDamage->maxRects)
+                RegionCopy(&oldRegion, &pDamage->damage);
             RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+            if (damageLimitRegion(pDamage, &pDamage->damage))
+                RegionSubtract(&tmpRegion, &pDamage->damage, &oldRegion);
+            RegionUninit(&oldRegion);
             (*pDamage->damageReport) (pDamage, &tmpRegion, pDamage->closure);
         }
         RegionUninit(&tmpRegion);
@@ -1934,6 +2109,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     case DamageReportBoundingBox:
         tmpBox = *RegionExtents(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         if (!BOX_SAME(&tmpBox, RegionExtents(&pDamage->damage))) {
             (*pDamage->damageReport) (pDamage, &pDamage->damage,
                                       pDamage->closure);
@@ -1942,6 +2118,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     case DamageReportNonEmpty:
         was_empty = !RegionNotEmpty(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         if (was_empty && RegionNotEmpty(&pDamage->damage)) {
             (*pDamage->damageReport) (pDamage, &pDamage->damage,
                                       pDamage->closure);
@@ -1949,6 +2126,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
         break;
     case DamageReportNone:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         break;
     }
 }
@@ -110,6 +110,12 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter);
 
+/* Pixels of overdraw one damage box is worth, see DamageSetRectLimit */
+#define DAMAGE_RECT_COST 1024
+
+extern _X_EXPORT void
+ DamageSetRectLimit(DamagePtr pDamage, int maxRects, int rectCost);
+
 extern _X_EXPORT DamageScreenFuncsPtr DamageGetScreenFuncs(ScreenPtr);
 
 #endif                          /* _DAMAGE_H_ */
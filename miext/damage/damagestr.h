@@ -49,6 +49,9 @@ typedef struct _damage {
     Bool reportAfter;
     RegionRec pendingDamage;    /* will be flushed post submission at the latest */
     ScreenPtr pScreen;
+
+    int maxRects;               /* 0: no limit, see DamageSetRectLimit */
+    int rectCost;
 } DamageRec;
 
 typedef struct _damageScrPriv {
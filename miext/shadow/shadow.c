@@ -43,6 +43,9 @@ static DevPrivateKeyRec shadowScrPrivateKeyRec;
     dixLookupPrivate(&(pScr)->devPrivates, shadowScrPrivateKey))
 #define shadowBuf(pScr)            shadowBufPtr pBuf = shadowGetBuf(pScr)
 
+/* box limit for the shadow damage, see DamageSetRectLimit */
+#define SHADOW_DAMAGE_RECTS 64
+
 #define wrap(priv, real, mem) {\
     priv->mem = real->mem; \
     real->mem = shadow##mem; \
@@ -132,6 +135,8 @@ shadowSetup(ScreenPtr pScreen)
         free(pBuf);
         return FALSE;
     }
+    /* every box costs a separate copy and conversion in the update hook */
+    DamageSetRectLimit(pBuf->pDamage, SHADOW_DAMAGE_RECTS, 0);
 
     wrap(pBuf, pScreen, CloseScreen);
     wrap(pBuf, pScreen, GetImage);
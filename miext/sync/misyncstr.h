@@ -50,6 +50,7 @@ typedef struct _SyncCounter {
     SyncObject sync;            /* Common sync object data */
     int64_t value;              /* counter value */
     struct _SysCounterInfo *pSysCounterInfo; /* NULL if not a system counter */
+    struct _SyncTriggerIndex *pTrigIndex; /* triggers sorted by test value */
 } SyncCounter;
 
 struct _SyncFence {
@@ -75,6 +76,10 @@ struct _SyncTrigger {
 typedef struct _SyncTriggerList {
     SyncTrigger *pTrigger;
     struct _SyncTriggerList *next;
+    /* counter triggers only: where the trigger sits in pTrigIndex */
+    unsigned int test_type;
+    int64_t test_value;
+    unsigned long serial;       /* higher is nearer the head of the list */
 } SyncTriggerList;
 
 extern DevPrivateKeyRec miSyncScreenPrivateKey;
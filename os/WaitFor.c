@@ -94,26 +94,156 @@ SOFTWARE.
 #include <X11/extensions/dpmsconst.h>
 #endif
 
+/*
+ * Pending timers are kept in a hierarchical timing wheel.  Level 0 has a
+ * slot for each of the next WHEEL_SIZE milliseconds after wheel_time and
+ * each level above has slots WHEEL_SIZE times as wide, so setting and
+ * cancelling a timer takes constant time.  When wheel_time enters the
+ * period of a higher level slot, its timers are moved down to the level
+ * matching their remaining time; a timer is due once it sits in the
+ * level 0 slot of wheel_time.  wheel_used has a bit for each slot that
+ * holds timers, so idle periods are skipped in a few steps.
+ */
+#define WHEEL_BITS      5
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    7       /* enough levels for 32 bits of time */
+
 struct _OsTimerRec {
     struct xorg_list list;
     CARD32 expires;
     CARD32 delta;
     OsTimerCallback callback;
     void *arg;
+    int slot;                   /* index into wheel */
+    CARD32 order;               /* when it was set, for equal expiries */
 };
 
 static void DoTimer(OsTimerPtr timer, CARD32 now);
 static void DoTimers(CARD32 now);
 static void CheckAllTimers(void);
-static volatile struct xorg_list timers;
+static struct xorg_list wheel[WHEEL_LEVELS * WHEEL_SIZE];
+static CARD32 wheel_used[WHEEL_LEVELS];
+static CARD32 wheel_time;
+static CARD32 wheel_seen;       /* latest time a timer was set or checked */
+static CARD32 wheel_order;
+
+static inline Bool
+wheel_empty(void)
+{
+    int level;
 
-static inline OsTimerPtr
-first_timer(void)
+    for (level = 0; level < WHEEL_LEVELS; level++)
+        if (wheel_used[level])
+            return FALSE;
+    return TRUE;
+}
+
+static void
+wheel_insert(OsTimerPtr timer)
 {
-    /* inline xorg_list_is_empty which can't handle volatile */
-    if (timers.next == &timers)
-        return NULL;
-    return xorg_list_first_entry(&timers, struct _OsTimerRec, list);
+    CARD32 delta = timer->expires - wheel_time;
+    CARD32 when = timer->expires;
+    struct xorg_list *pos;
+    int level = 0;
+
+    /* overdue timers go in the slot that runs next */
+    if ((int) delta < 0) {
+        delta = 0;
+        when = wheel_time;
+    }
+    while (level < WHEEL_LEVELS - 1 && delta >> (WHEEL_BITS * (level + 1)))
+        level++;
+
+    timer->slot = level * WHEEL_SIZE +
+        ((when >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+    /* timers expiring together run in the order they were set, so one
+     * moved down from a higher level goes before those set after it */
+    pos = &wheel[timer->slot];
+    while (pos->prev != &wheel[timer->slot]) {
+        OsTimerPtr prev = xorg_list_last_entry(pos, struct _OsTimerRec, list);
+
+        if ((int) (prev->order - timer->order) < 0)
+            break;
+        pos = pos->prev;
+    }
+    xorg_list_append(&timer->list, pos);
+    wheel_used[level] |= 1U << (timer->slot & WHEEL_MASK);
+}
+
+static void
+wheel_remove(OsTimerPtr timer)
+{
+    xorg_list_del(&timer->list);
+    if (xorg_list_is_empty(&wheel[timer->slot]))
+        wheel_used[timer->slot / WHEEL_SIZE] &=
+            ~(1U << (timer->slot & WHEEL_MASK));
+}
+
+/* Offset from index to the next used slot in the ring, or -1 */
+static int
+wheel_find(CARD32 used, int index)
+{
+    if (index)
+        used = (used >> index) | (used << (WHEEL_SIZE - index));
+    return used ? ffs(used) - 1 : -1;
+}
+
+/*
+ * Find the earliest time a timer may be due.  This is exact for timers
+ * in level 0; for the levels above it is the start of the first used
+ * slot, when its timers must be moved down.
+ */
+static Bool
+wheel_next(CARD32 *next)
+{
+    Bool found = FALSE;
+    CARD32 period, start;
+    int level, shift, k;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        shift = WHEEL_BITS * level;
+        period = wheel_time >> shift;
+        /* slots of the current period above level 0 were already moved */
+        if (level)
+            period++;
+        k = wheel_find(wheel_used[level], period & WHEEL_MASK);
+        if (k < 0)
+            continue;
+        start = (period + k) << shift;
+        if (!found || start - wheel_time < *next - wheel_time)
+            *next = start;
+        found = TRUE;
+    }
+    return found;
+}
+
+/*
+ * Move wheel_time forward to now, or to the next slot needing attention
+ * if that comes first, moving down the timers of the slots entered.
+ */
+static void
+wheel_advance(CARD32 now)
+{
+    CARD32 next, old = wheel_time;
+    OsTimerPtr timer, tmp;
+    int level, shift, slot;
+
+    if (!wheel_next(&next) || next - old > now - old)
+        next = now;
+    wheel_time = next;
+
+    for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+        shift = WHEEL_BITS * level;
+        if ((old >> shift) == (next >> shift))
+            continue;
+        slot = level * WHEEL_SIZE + ((next >> shift) & WHEEL_MASK);
+        xorg_list_for_each_entry_safe(timer, tmp, &wheel[slot], list) {
+            wheel_remove(timer);
+            wheel_insert(timer);
+        }
+    }
 }
 
 /*
@@ -123,26 +253,33 @@ first_timer(void)
 static int
 check_timers(void)
 {
-    OsTimerPtr timer;
-
-    if ((timer = first_timer()) != NULL) {
-        CARD32 now = GetTimeInMillis();
-        int timeout = timer->expires - now;
-
-        if (timeout <= 0) {
-            DoTimers(now);
-        } else {
-            /* Make sure the timeout is sane */
-            if (timeout < timer->delta + 250)
-                return timeout;
+    CARD32 now, next;
+    int timeout = -1;
 
+    input_lock();
+    if (wheel_next(&next)) {
+        now = GetTimeInMillis();
+        /* behind the wheel, or well behind when the latest timer was
+         * set, which covers every timer's expires - now > delta + 250 */
+        if ((int) (now - wheel_time) < 0 ||
+            (int) (wheel_seen - now) > 250) {
             /* time has rewound.  reset the timers. */
             CheckAllTimers();
+            timeout = 0;
+        }
+        else {
+            if ((int) (now - wheel_seen) > 0)
+                wheel_seen = now;
+            if ((int) (next - now) <= 0) {
+                DoTimers(now);
+                timeout = 0;
+            }
+            else
+                timeout = next - now;
         }
-
-        return 0;
     }
-    return -1;
+    input_unlock();
+    return timeout;
 }
 
 /*****************
@@ -245,23 +382,34 @@ static inline Bool timer_pending(OsTimerPtr timer) {
     return !xorg_list_is_empty(&timer->list);
 }
 
-/* If time has rewound, re-run every affected timer.
- * Timers might drop out of the list, so we have to restart every time. */
+/* If time has rewound, re-run every affected timer and restart the wheel
+ * from the current time.  Timers might drop out of the list, so take
+ * them one at a time. */
 static void
 CheckAllTimers(void)
 {
-    OsTimerPtr timer;
+    struct xorg_list rewound;
+    OsTimerPtr timer, tmp;
     CARD32 now;
+    int i;
 
     input_lock();
- start:
-    now = GetTimeInMillis();
+    xorg_list_init(&rewound);
+    for (i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++) {
+        xorg_list_for_each_entry_safe(timer, tmp, &wheel[i], list) {
+            wheel_remove(timer);
+            xorg_list_append(&timer->list, &rewound);
+        }
+    }
 
-    xorg_list_for_each_entry(timer, &timers, list) {
-        if (timer->expires - now > timer->delta + 250) {
+    now = GetTimeInMillis();
+    wheel_time = wheel_seen = now;
+    while (!xorg_list_is_empty(&rewound)) {
+        timer = xorg_list_first_entry(&rewound, struct _OsTimerRec, list);
+        xorg_list_del(&timer->list);
+        wheel_insert(timer);
+        if (timer->expires - now > timer->delta + 250)
             DoTimer(timer, now);
-            goto start;
-        }
     }
     input_unlock();
 }
@@ -271,7 +419,7 @@ DoTimer(OsTimerPtr timer, CARD32 now)
 {
     CARD32 newTime;
 
-    xorg_list_del(&timer->list);
+    wheel_remove(timer);
     newTime = (*timer->callback) (timer, now, timer->arg);
     if (newTime)
         TimerSet(timer, 0, newTime, timer->callback, timer->arg);
@@ -280,13 +428,20 @@ DoTimer(OsTimerPtr timer, CARD32 now)
 static void
 DoTimers(CARD32 now)
 {
-    OsTimerPtr  timer;
+    struct xorg_list *slot;
 
     input_lock();
-    while ((timer = first_timer())) {
-        if ((int) (timer->expires - now) > 0)
+    if ((int) (now - wheel_time) < 0)
+        CheckAllTimers();
+    for (;;) {
+        slot = &wheel[wheel_time & WHEEL_MASK];
+        if (!xorg_list_is_empty(slot))
+            DoTimer(xorg_list_first_entry(slot, struct _OsTimerRec, list),
+                    now);
+        else if ((int) (now - wheel_time) > 0)
+            wheel_advance(now);
+        else
             break;
-        DoTimer(timer, now);
     }
     input_unlock();
 }
@@ -295,7 +450,6 @@ OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    OsTimerPtr existing, tmp;
     CARD32 now = GetTimeInMillis();
 
     if (!timer) {
@@ -307,7 +461,7 @@ TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
     else {
         input_lock();
         if (timer_pending(timer)) {
-            xorg_list_del(&timer->list);
+            wheel_remove(timer);
             if (flags & TimerForceOld)
                 (void) (*timer->callback) (timer, now, timer->arg);
         }
@@ -326,13 +480,14 @@ TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
     timer->callback = func;
     timer->arg = arg;
     input_lock();
+    timer->order = wheel_order++;
 
-    /* Sort into list */
-    xorg_list_for_each_entry_safe(existing, tmp, &timers, list)
-        if ((int) (existing->expires - millis) > 0)
-            break;
-    /* This even works at the end of the list -- existing->list will be timers */
-    xorg_list_add(&timer->list, existing->list.prev);
+    /* an idle wheel may be far behind, restart it from now */
+    if (wheel_empty())
+        wheel_time = wheel_seen = now;
+    else if ((int) (now - wheel_seen) > 0)
+        wheel_seen = now;
+    wheel_insert(timer);
 
     /* Check to see if the timer is ready to run now */
     if ((int) (millis - now) <= 0)
@@ -361,7 +516,8 @@ TimerCancel(OsTimerPtr timer)
     if (!timer)
         return;
     input_lock();
-    xorg_list_del(&timer->list);
+    if (timer_pending(timer))
+        wheel_remove(timer);
     input_unlock();
 }
 
@@ -385,16 +541,21 @@ TimerInit(void)
 {
     static Bool been_here;
     OsTimerPtr timer, tmp;
+    int i;
 
     if (!been_here) {
         been_here = TRUE;
-        xorg_list_init((struct xorg_list*) &timers);
+        for (i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++)
+            xorg_list_init(&wheel[i]);
     }
 
-    xorg_list_for_each_entry_safe(timer, tmp, &timers, list) {
-        xorg_list_del(&timer->list);
-        free(timer);
+    for (i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++) {
+        xorg_list_for_each_entry_safe(timer, tmp, &wheel[i], list) {
+            xorg_list_del(&timer->list);
+            free(timer);
+        }
     }
+    memset(wheel_used, 0, sizeof(wheel_used));
 }
 
 #ifdef DPMSExtension
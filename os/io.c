@@ -70,6 +70,10 @@ SOFTWARE.
 #if !defined(WIN32)
 #include <sys/uio.h>
 #endif
+#ifdef HAVE_LIBURING
+#include <sys/socket.h>
+#include <liburing.h>
+#endif
 #include <X11/X.h>
 #include <X11/Xproto.h>
 #include "os.h"
@@ -89,6 +93,7 @@ typedef struct _connectionInput {
     int lenLastReq;
     int size;
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
+    CARD32 bigTime;             /* when the last big request was read */
 } ConnectionInput;
 
 typedef struct _connectionOutput {
@@ -100,11 +105,17 @@ typedef struct _connectionOutput {
 
 static ConnectionInputPtr AllocateInputBuffer(void);
 static ConnectionOutputPtr AllocateOutputBuffer(void);
+static void ReleaseInputBuffer(ConnectionInputPtr oci);
+static void ReleaseOutputBuffer(ConnectionOutputPtr oco);
+static void AbortClient(ClientPtr client);
 
 static Bool CriticalOutputPending;
 static int timesThisConnection = 0;
 static ConnectionInputPtr FreeInputs = (ConnectionInputPtr) NULL;
 static ConnectionOutputPtr FreeOutputs = (ConnectionOutputPtr) NULL;
+static int numFreeInputs;
+static int numFreeOutputs;
+static OsBufferStatsRec bufferStats;
 static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 
 #define get_req_len(req,cli) ((cli)->swapped ? \
@@ -119,6 +130,29 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 #define BUFSIZE 16384
 #define BUFWATERMARK 32768
 
+/*
+ * Clients streaming large requests (e.g. full frame PutImage) would
+ * otherwise get their input buffer shrunk and regrown for every request,
+ * paying for a fresh multi-megabyte allocation and its page faults each
+ * time.  Keep the grown buffer for BIGREQ_RETAIN_MS after the last request
+ * larger than BUFWATERMARK.  Idle clients holding such a buffer are
+ * tracked in RetainedInputs, at most BIGREQ_RETAIN_MAX of them, so it is
+ * released once they go quiet even if they never read again.
+ */
+#define BIGREQ_RETAIN_MS 250
+#define BIGREQ_RETAIN_MAX 4
+
+static OsCommPtr RetainedInputs[BIGREQ_RETAIN_MAX];
+static int numRetainedInputs;
+
+/*
+ * Connection buffers of the default size are recycled through the
+ * FreeInputs and FreeOutputs pools, so that clients connecting and
+ * disconnecting at a high rate don't go through the allocator every
+ * time.  Each pool holds at most this many buffers.
+ */
+#define BUFPOOLSIZE 32
+
 /*
  *   A lot of the code in this file manipulates a ConnectionInputPtr:
  *
@@ -197,6 +231,25 @@ YieldControlDeath(void)
     timesThisConnection = 0;
 }
 
+static Bool
+BigInputRecent(ConnectionInputPtr oci, CARD32 now)
+{
+    return oci->size > BUFWATERMARK && now - oci->bigTime < BIGREQ_RETAIN_MS;
+}
+
+static void
+ForgetRetainedInput(OsCommPtr oc)
+{
+    int i;
+
+    for (i = 0; i < numRetainedInputs; i++) {
+        if (RetainedInputs[i] == oc) {
+            RetainedInputs[i] = RetainedInputs[--numRetainedInputs];
+            return;
+        }
+    }
+}
+
 /* If an input buffer was empty, either free it if it is too big or link it
  * into our list of free input buffers.  This means that different clients can
  * share the same input buffer (at different times).  This was done to save
@@ -205,22 +258,48 @@ YieldControlDeath(void)
 static void
 NextAvailableInput(OsCommPtr oc)
 {
+    CARD32 now;
+    int i;
+
+    /* a client reading again manages its own buffer */
+    if (numRetainedInputs)
+        ForgetRetainedInput(oc);
+
     if (AvailableInput) {
         if (AvailableInput != oc) {
             ConnectionInputPtr aci = AvailableInput->input;
 
-            if (aci->size > BUFWATERMARK) {
-                free(aci->buffer);
-                free(aci);
+            if (aci->ignoreBytes) {
+                /* in the middle of skipping a request, keep the buffer */
+            }
+            else if (aci->size > BUFWATERMARK &&
+                     numRetainedInputs < BIGREQ_RETAIN_MAX &&
+                     BigInputRecent(aci, GetTimeInMillis())) {
+                /* still streaming large requests, keep the buffer for now */
+                RetainedInputs[numRetainedInputs++] = AvailableInput;
             }
             else {
-                aci->next = FreeInputs;
-                FreeInputs = aci;
+                ReleaseInputBuffer(aci);
+                AvailableInput->input = NULL;
             }
-            AvailableInput->input = NULL;
         }
         AvailableInput = NULL;
     }
+
+    if (numRetainedInputs) {
+        now = GetTimeInMillis();
+        for (i = 0; i < numRetainedInputs;) {
+            OsCommPtr roc = RetainedInputs[i];
+
+            if (BigInputRecent(roc->input, now)) {
+                i++;
+                continue;
+            }
+            ReleaseInputBuffer(roc->input);
+            roc->input = NULL;
+            RetainedInputs[i] = RetainedInputs[--numRetainedInputs];
+        }
+    }
 }
 
 int
@@ -239,10 +318,7 @@ ReadRequestFromClient(ClientPtr client)
     /* make sure we have an input buffer */
 
     if (!oci) {
-        if ((oci = FreeInputs)) {
-            FreeInputs = oci->next;
-        }
-        else if (!(oci = AllocateInputBuffer())) {
+        if (!(oci = AllocateInputBuffer())) {
             YieldControlDeath();
             return -1;
         }
@@ -331,6 +407,7 @@ ReadRequestFromClient(ClientPtr client)
                     YieldControlDeath();
                     return -1;
                 }
+                bufferStats.input_grown++;
                 oci->size = needed;
                 oci->buffer = ibuf;
             }
@@ -367,9 +444,26 @@ ReadRequestFromClient(ClientPtr client)
         }
         oci->bufcnt += result;
         gotnow += result;
+        /* the client filled the whole buffer, so it probably has more
+         * queued; let it read in larger chunks from now on.  Not while
+         * skipping an oversized request: needed is pinned to the old
+         * size then. */
+        if (oci->bufcnt == oci->size && oci->size < BUFWATERMARK &&
+            !oci->ignoreBytes) {
+            char *ibuf;
+
+            ibuf = (char *) realloc(oci->buffer, BUFWATERMARK);
+            if (ibuf) {
+                oci->bufptr = ibuf + (oci->bufptr - oci->buffer);
+                oci->buffer = ibuf;
+                oci->size = BUFWATERMARK;
+                bufferStats.input_grown++;
+            }
+        }
         /* free up some space after huge requests */
         if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
+            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE) &&
+            !BigInputRecent(oci, GetTimeInMillis())) {
             char *ibuf;
 
             ibuf = (char *) realloc(oci->buffer, BUFSIZE);
@@ -428,6 +522,8 @@ ReadRequestFromClient(ClientPtr client)
     }
 
     oci->lenLastReq = needed;
+    if (needed > BUFWATERMARK)
+        oci->bigTime = GetTimeInMillis();
 
     /*
      *  Check to see if client has at least one whole request in the
@@ -488,6 +584,8 @@ WriteFdToClient(ClientPtr client, int fd, Bool do_close)
 #if XTRANS_SEND_FDS
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
 
+    /* the fd goes out with the next write through xtrans */
+    oc->flags |= OS_COMM_FDS_PENDING;
     return _XSERVTransSendFd(oc->trans_conn, fd, do_close);
 #else
     return -1;
@@ -510,9 +608,7 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
     NextAvailableInput(oc);
 
     if (!oci) {
-        if ((oci = FreeInputs))
-            FreeInputs = oci->next;
-        else if (!(oci = AllocateInputBuffer()))
+        if (!(oci = AllocateInputBuffer()))
             return FALSE;
         oc->input = oci;
     }
@@ -589,6 +685,170 @@ ResetCurrentRequest(ClientPtr client)
     }
 }
 
+#ifdef HAVE_LIBURING
+
+/*
+ * With io_uring, FlushAllOutput queues a send for every client with
+ * pending output and submits them all with a single system call, instead
+ * of calling writev once per client.  Clients with file descriptors
+ * queued in xtrans still go through FlushClient, as only xtrans knows how
+ * to send those.
+ */
+
+#define FLUSH_RING_ENTRIES 256
+
+Bool UseIoUring = TRUE;
+
+static struct io_uring flushRing;
+static enum { ring_untried, ring_ready, ring_failed } flushRingState;
+
+static Bool
+FlushRingReady(void)
+{
+    int ret;
+
+    if (flushRingState == ring_untried) {
+        ret = io_uring_queue_init(FLUSH_RING_ENTRIES, &flushRing, 0);
+        if (ret < 0) {
+            LogMessage(X_WARNING, "io_uring unavailable (%s), "
+                       "flushing clients one at a time\n", strerror(-ret));
+            flushRingState = ring_failed;
+        }
+        else
+            flushRingState = ring_ready;
+    }
+    return flushRingState == ring_ready;
+}
+
+/* Finish a send submitted by FlushClientsBatched */
+static void
+FlushClientCompleted(ClientPtr who, int result)
+{
+    OsCommPtr oc = (OsCommPtr) who->osPrivate;
+    ConnectionOutputPtr oco = oc->output;
+
+    if (result == oco->count) {
+        oco->count = 0;
+        output_pending_clear(who);
+        ReleaseOutputBuffer(oco);
+        oc->output = (ConnectionOutputPtr) NULL;
+    }
+    else if (result >= 0 || ETEST(-result) || result == -EINTR) {
+        /* The client is not keeping up, buffer the rest as FlushClient
+         * would */
+        if (result > 0) {
+            oco->count -= result;
+            memmove((char *) oco->buf, (char *) oco->buf + result, oco->count);
+        }
+        if (result == -EINTR)
+            NewOutputPending = TRUE;
+        else
+            ospoll_listen(server_poll, oc->fd, X_NOTIFY_WRITE);
+    }
+    else {
+        AbortClient(who);
+        MarkClientException(who);
+        oco->count = 0;
+    }
+}
+
+/*
+ * Wait for the completions of the first 'count' sends in 'batch', which
+ * is all of them that reached the kernel.  Every submitted send must be
+ * reaped here: a completion left in the ring would be matched against the
+ * next batch, and its client would have the same bytes sent again.
+ * Returns FALSE if the ring failed; clients whose sends are then in an
+ * unknown state are dropped, since their output can't be resent safely.
+ */
+static Bool
+FlushRingReap(ClientPtr *batch, int count)
+{
+    struct io_uring_cqe *cqe;
+    int i, index, ret;
+
+    for (i = 0; i < count; i++) {
+        do {
+            ret = io_uring_wait_cqe(&flushRing, &cqe);
+        } while (ret == -EINTR);
+        if (ret < 0)
+            break;
+        index = (intptr_t) io_uring_cqe_get_data(cqe);
+        FlushClientCompleted(batch[index], cqe->res);
+        batch[index] = NULL;
+        io_uring_cqe_seen(&flushRing, cqe);
+    }
+    if (i == count)
+        return TRUE;
+
+    for (i = 0; i < count; i++) {
+        if (batch[i]) {
+            OsCommPtr oc = (OsCommPtr) batch[i]->osPrivate;
+
+            AbortClient(batch[i]);
+            MarkClientException(batch[i]);
+            oc->output->count = 0;
+        }
+    }
+    return FALSE;
+}
+
+static void
+FlushClientsBatched(void)
+{
+    ClientPtr batch[FLUSH_RING_ENTRIES];
+    ClientPtr client, tmp;
+    struct io_uring_sqe *sqe;
+    OsCommPtr oc;
+    int i, ret, n = 0, submitted = 0;
+
+    xorg_list_for_each_entry_safe(client, tmp, &output_pending_clients, output_pending) {
+        if (client->clientGone)
+            continue;
+        if (client_is_ready(client)) {
+            NewOutputPending = TRUE;
+            continue;
+        }
+        oc = (OsCommPtr) client->osPrivate;
+        if (!oc->output || !oc->output->count || !oc->trans_conn ||
+            (oc->flags & OS_COMM_FDS_PENDING) || n == FLUSH_RING_ENTRIES ||
+            !(sqe = io_uring_get_sqe(&flushRing))) {
+            (void) FlushClient(client, oc, (char *) NULL, 0);
+            continue;
+        }
+        if (FlushCallback)
+            CallCallbacks(&FlushCallback, client);
+        io_uring_prep_send(sqe, oc->fd, oc->output->buf, oc->output->count,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+        io_uring_sqe_set_data(sqe, (void *) (intptr_t) n);
+        batch[n++] = client;
+    }
+    if (!n)
+        return;
+
+    /* The kernel takes queued sends in order, and may take fewer than
+     * were queued in one go */
+    while (submitted < n) {
+        ret = io_uring_submit(&flushRing);
+        if (ret == -EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        submitted += ret;
+    }
+
+    if (FlushRingReap(batch, submitted) && submitted == n)
+        return;
+
+    /* The ring is broken.  Tearing it down drops any sends still queued;
+     * flush those clients the usual way, as will be done from now on */
+    io_uring_queue_exit(&flushRing);
+    flushRingState = ring_failed;
+    for (i = submitted; i < n; i++)
+        (void) FlushClient(batch[i], batch[i]->osPrivate, (char *) NULL, 0);
+}
+
+#endif /* HAVE_LIBURING */
+
  /********************
  * FlushAllOutput()
  *    Flush all clients with output.  However, if some client still
@@ -617,6 +877,13 @@ FlushAllOutput(void)
     CriticalOutputPending = FALSE;
     NewOutputPending = FALSE;
 
+#ifdef HAVE_LIBURING
+    if (UseIoUring && FlushRingReady()) {
+        FlushClientsBatched();
+        return;
+    }
+#endif
+
     xorg_list_for_each_entry_safe(client, tmp, &output_pending_clients, output_pending) {
         if (client->clientGone)
             continue;
@@ -732,10 +999,7 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
 #endif
 
     if (!oco) {
-        if ((oco = FreeOutputs)) {
-            FreeOutputs = oco->next;
-        }
-        else if (!(oco = AllocateOutputBuffer())) {
+        if (!(oco = AllocateOutputBuffer())) {
             AbortClient(who);
             MarkClientException(who);
             return -1;
@@ -912,9 +1176,16 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 
             if (notWritten > oco->size) {
                 unsigned char *obuf = NULL;
-
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
+                long size = notWritten + BUFSIZE;
+
+                /* grow geometrically so a client that keeps falling
+                 * behind doesn't reallocate on every reply */
+                if (size < (long) oco->size * 2)
+                    size = (long) oco->size * 2;
+                if (size > INT_MAX)
+                    size = notWritten + BUFSIZE;
+                if (size <= INT_MAX) {
+                    obuf = realloc(oco->buf, size);
                 }
                 if (!obuf) {
                     AbortClient(who);
@@ -922,7 +1193,8 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
                     oco->count = 0;
                     return -1;
                 }
-                oco->size = notWritten + BUFSIZE;
+                bufferStats.output_grown++;
+                oco->size = size;
                 oco->buf = obuf;
             }
 
@@ -953,16 +1225,10 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 
     /* everything was flushed out */
     oco->count = 0;
+    oc->flags &= ~OS_COMM_FDS_PENDING;
     output_pending_clear(who);
 
-    if (oco->size > BUFWATERMARK) {
-        free(oco->buf);
-        free(oco);
-    }
-    else {
-        oco->next = FreeOutputs;
-        FreeOutputs = oco;
-    }
+    ReleaseOutputBuffer(oco);
     oc->output = (ConnectionOutputPtr) NULL;
     return extraCount;          /* return only the amount explicitly requested */
 }
@@ -972,6 +1238,13 @@ AllocateInputBuffer(void)
 {
     ConnectionInputPtr oci;
 
+    if ((oci = FreeInputs)) {
+        FreeInputs = oci->next;
+        numFreeInputs--;
+        bufferStats.input_reused++;
+        return oci;
+    }
+
     oci = malloc(sizeof(ConnectionInput));
     if (!oci)
         return NULL;
@@ -985,6 +1258,8 @@ AllocateInputBuffer(void)
     oci->bufcnt = 0;
     oci->lenLastReq = 0;
     oci->ignoreBytes = 0;
+    oci->bigTime = 0;
+    bufferStats.input_allocated++;
     return oci;
 }
 
@@ -993,6 +1268,13 @@ AllocateOutputBuffer(void)
 {
     ConnectionOutputPtr oco;
 
+    if ((oco = FreeOutputs)) {
+        FreeOutputs = oco->next;
+        numFreeOutputs--;
+        bufferStats.output_reused++;
+        return oco;
+    }
+
     oco = malloc(sizeof(ConnectionOutput));
     if (!oco)
         return NULL;
@@ -1003,42 +1285,64 @@ AllocateOutputBuffer(void)
     }
     oco->size = BUFSIZE;
     oco->count = 0;
+    bufferStats.output_allocated++;
     return oco;
 }
 
+/* Return an empty input buffer to the pool, or free it */
+static void
+ReleaseInputBuffer(ConnectionInputPtr oci)
+{
+    if (oci->size > BUFWATERMARK || numFreeInputs >= BUFPOOLSIZE) {
+        free(oci->buffer);
+        free(oci);
+        bufferStats.input_freed++;
+        return;
+    }
+    oci->bufptr = oci->buffer;
+    oci->bufcnt = 0;
+    oci->lenLastReq = 0;
+    oci->ignoreBytes = 0;
+    oci->bigTime = 0;
+    oci->next = FreeInputs;
+    FreeInputs = oci;
+    numFreeInputs++;
+}
+
+/* Return an empty output buffer to the pool, or free it */
+static void
+ReleaseOutputBuffer(ConnectionOutputPtr oco)
+{
+    if (oco->size > BUFWATERMARK || numFreeOutputs >= BUFPOOLSIZE) {
+        free(oco->buf);
+        free(oco);
+        bufferStats.output_freed++;
+        return;
+    }
+    oco->count = 0;
+    oco->next = FreeOutputs;
+    FreeOutputs = oco;
+    numFreeOutputs++;
+}
+
 void
 FreeOsBuffers(OsCommPtr oc)
 {
-    ConnectionInputPtr oci;
-    ConnectionOutputPtr oco;
-
     if (AvailableInput == oc)
         AvailableInput = (OsCommPtr) NULL;
-    if ((oci = oc->input)) {
-        if (FreeInputs) {
-            free(oci->buffer);
-            free(oci);
-        }
-        else {
-            FreeInputs = oci;
-            oci->next = (ConnectionInputPtr) NULL;
-            oci->bufptr = oci->buffer;
-            oci->bufcnt = 0;
-            oci->lenLastReq = 0;
-            oci->ignoreBytes = 0;
-        }
-    }
-    if ((oco = oc->output)) {
-        if (FreeOutputs) {
-            free(oco->buf);
-            free(oco);
-        }
-        else {
-            FreeOutputs = oco;
-            oco->next = (ConnectionOutputPtr) NULL;
-            oco->count = 0;
-        }
-    }
+    ForgetRetainedInput(oc);
+    if (oc->input)
+        ReleaseInputBuffer(oc->input);
+    if (oc->output)
+        ReleaseOutputBuffer(oc->output);
+}
+
+void
+GetOsBufferStats(OsBufferStatsPtr stats)
+{
+    *stats = bufferStats;
+    stats->input_pooled = numFreeInputs;
+    stats->output_pooled = numFreeOutputs;
 }
 
 void
@@ -1047,6 +1351,15 @@ ResetOsBuffers(void)
     ConnectionInputPtr oci;
     ConnectionOutputPtr oco;
 
+    LogMessageVerb(X_INFO, 3,
+                   "Connection buffers: input %lu allocated, %lu reused, "
+                   "%lu freed, %lu grown; output %lu allocated, %lu reused, "
+                   "%lu freed, %lu grown\n",
+                   bufferStats.input_allocated, bufferStats.input_reused,
+                   bufferStats.input_freed, bufferStats.input_grown,
+                   bufferStats.output_allocated, bufferStats.output_reused,
+                   bufferStats.output_freed, bufferStats.output_grown);
+
     while ((oci = FreeInputs)) {
         FreeInputs = oci->next;
         free(oci->buffer);
@@ -1057,4 +1370,6 @@ ResetOsBuffers(void)
         free(oco->buf);
         free(oco);
     }
+    numFreeInputs = 0;
+    numFreeOutputs = 0;
 }
@@ -123,6 +123,7 @@ typedef struct _osComm {
 
 #define OS_COMM_GRAB_IMPERVIOUS 1
 #define OS_COMM_IGNORED         2
+#define OS_COMM_FDS_PENDING     4
 
 extern int FlushClient(ClientPtr /*who */ ,
                        OsCommPtr /*oc */ ,
@@ -133,6 +134,10 @@ extern int FlushClient(ClientPtr /*who */ ,
 extern void FreeOsBuffers(OsCommPtr     /*oc */
     );
 
+#ifdef HAVE_LIBURING
+extern Bool UseIoUring;
+#endif
+
 void
 CloseDownFileDescriptor(OsCommPtr oc);
 
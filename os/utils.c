@@ -105,10 +105,12 @@ __stdcall unsigned long GetTickCount(void);
 #include "opaque.h"
 
 #include "dixstruct.h"
+#include "reqprof.h"
 
 #include "xkbsrv.h"
 
 #include "picture.h"
+#include "mi.h"
 
 Bool noTestExtensions;
 
@@ -516,6 +518,7 @@ UseMsg(void)
     ErrorF("c #                    key-click volume (0-100)\n");
     ErrorF("-cc int                default color visual class\n");
     ErrorF("-nocursor              disable the cursor\n");
+    ErrorF("-compressmotion        drop motion events superseded before delivery\n");
     ErrorF("-core                  generate core dump on fatal error\n");
     ErrorF("-displayfd fd          file descriptor to write display number to when ready to connect\n");
     ErrorF("-dpi int               screen resolution in dots per inch\n");
@@ -548,14 +551,21 @@ UseMsg(void)
     ErrorF("-nolisten string       don't listen on protocol\n");
     ErrorF("-listen string         listen on protocol\n");
     ErrorF("-noreset               don't reset after last client exists\n");
+#ifdef HAVE_LIBURING
+    ErrorF("-noiouring             flush client output without io_uring\n");
+#endif
     ErrorF("-background [none]     create root window with no background\n");
     ErrorF("-reset                 reset after last client exists\n");
+    ErrorF("-reqprof               profile requests, log the profile on SIGUSR2\n");
     ErrorF("-p #                   screen-saver pattern duration (minutes)\n");
+    ErrorF("-pixmappool kilobytes  memory kept for reuse by new pixmaps\n");
+    ErrorF("-pixmappoolhuge        use huge pages for large pooled pixmaps\n");
     ErrorF("-pn                    accept failure to listen on all ports\n");
     ErrorF("-nopn                  reject failure to listen on all ports\n");
     ErrorF("-r                     turns off auto-repeat\n");
     ErrorF("r                      turns on auto-repeat \n");
     ErrorF("-render [default|mono|gray|color] set render color alloc policy\n");
+    ErrorF("-renderthreads #       threads for large software rendering\n");
     ErrorF("-retro                 start with classic stipple and cursor\n");
     ErrorF("-s #                   screen-saver timeout (minutes)\n");
     ErrorF("-seat string           seat to run on\n");
@@ -576,6 +586,7 @@ UseMsg(void)
     ErrorF
         ("-dumbSched             Disable smart scheduling and threaded input, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedMax int          Set maximum scheduler time slice in msec\n");
     ErrorF("-sigstop               Enable SIGSTOP based startup\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
@@ -730,6 +741,9 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-compressmotion") == 0) {
+            mieqCompressMotion = TRUE;
+        }
         else if (strcmp(argv[i], "-core") == 0) {
 #if !defined(WIN32) || !defined(__MINGW32__)
             struct rlimit core_limit;
@@ -885,6 +899,14 @@ ProcessCommandLine(int argc, char *argv[])
         else if (strcmp(argv[i], "-noreset") == 0) {
             dispatchExceptionAtReset = 0;
         }
+#ifdef HAVE_LIBURING
+        else if (strcmp(argv[i], "-noiouring") == 0) {
+            UseIoUring = FALSE;
+        }
+#endif
+        else if (strcmp(argv[i], "-reqprof") == 0) {
+            RequestProfiling = TRUE;
+        }
         else if (strcmp(argv[i], "-reset") == 0) {
             dispatchExceptionAtReset = DE_RESET;
         }
@@ -895,6 +917,15 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-pixmappool") == 0) {
+            if (++i < argc)
+                PixmapPoolLimit = strtoul(argv[i], NULL, 0) << 10;
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-pixmappoolhuge") == 0) {
+            PixmapPoolHugePages = TRUE;
+        }
         else if (strcmp(argv[i], "-pogo") == 0) {
             dispatchException = DE_TERMINATE;
         }
@@ -1027,6 +1058,18 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-renderthreads") == 0) {
+            if (++i < argc) {
+                PictureRenderThreads = atoi(argv[i]);
+#if !INPUTTHREAD
+                if (PictureRenderThreads > 1)
+                    ErrorF("Warning: -renderthreads ignored, the server "
+                           "was built without thread support\n");
+#endif
+            }
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-sigstop") == 0) {
             RunFromSigStopParent = TRUE;
         }
@@ -25,16 +25,13 @@
 #endif
 
 #include "present_priv.h"
-#include "list.h"
 
-static struct xorg_list fake_vblank_queue;
-
-typedef struct present_fake_vblank {
-    struct xorg_list            list;
-    uint64_t                    event_id;
-    OsTimerPtr                  timer;
-    ScreenPtr                   screen;
-} present_fake_vblank_rec, *present_fake_vblank_ptr;
+/*
+ * Fake vblanks for a screen wait on its fake_timeline in MSC order, with
+ * a single timer armed for the earliest one. Every event that is due when
+ * the timer fires is delivered from that one callback, so hundreds of
+ * windows presenting at the same frame cost one timer, not hundreds.
+ */
 
 int
 present_fake_get_ust_msc(ScreenPtr screen, uint64_t *ust, uint64_t *msc)
@@ -55,33 +52,67 @@ present_fake_notify(ScreenPtr screen, uint64_t event_id)
     present_event_notify(event_id, ust, msc);
 }
 
+/*
+ * Last MSC that counts as reached at 'now': anything less than a
+ * millisecond away is delivered right away, as the timer can't wait
+ * for it anyway
+ */
+static uint64_t
+present_fake_due_msc(present_screen_priv_ptr screen_priv, uint64_t now)
+{
+    return (now + 999) / screen_priv->fake_interval;
+}
+
+static CARD32
+present_fake_do_timer(OsTimerPtr timer, CARD32 time, void *arg);
+
+static Bool
+present_fake_arm_timer(ScreenPtr screen)
+{
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    uint64_t                    msc;
+    INT32                       delay;
+
+    if (!present_timeline_first(&screen_priv->fake_timeline, &msc)) {
+        TimerCancel(screen_priv->fake_timer);
+        return TRUE;
+    }
+
+    delay = ((int64_t) (msc * screen_priv->fake_interval - GetTimeInMicros())) / 1000;
+    screen_priv->fake_timer = TimerSet(screen_priv->fake_timer, 0, max(delay, 1),
+                                       present_fake_do_timer, screen);
+    return screen_priv->fake_timer != NULL;
+}
+
 static CARD32
 present_fake_do_timer(OsTimerPtr timer,
                       CARD32 time,
                       void *arg)
 {
-    present_fake_vblank_ptr     fake_vblank = arg;
+    ScreenPtr                   screen = arg;
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    uint64_t                    due = present_fake_due_msc(screen_priv, GetTimeInMicros());
+    uint64_t                    event_id;
 
-    present_fake_notify(fake_vblank->screen, fake_vblank->event_id);
-    xorg_list_del(&fake_vblank->list);
-    TimerFree(fake_vblank->timer);
-    free(fake_vblank);
+    /* Events queued from the notify callbacks are never due yet, so this
+     * terminates
+     */
+    while (present_timeline_retire(&screen_priv->fake_timeline, due, &event_id))
+        present_fake_notify(screen, event_id);
+
+    present_fake_arm_timer(screen);
     return 0;
 }
 
 void
 present_fake_abort_vblank(ScreenPtr screen, uint64_t event_id, uint64_t msc)
 {
-    present_fake_vblank_ptr     fake_vblank, tmp;
-
-    xorg_list_for_each_entry_safe(fake_vblank, tmp, &fake_vblank_queue, list) {
-        if (fake_vblank->event_id == event_id) {
-            TimerFree(fake_vblank->timer); /* TimerFree will call TimerCancel() */
-            xorg_list_del(&fake_vblank->list);
-            free (fake_vblank);
-            break;
-        }
-    }
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+
+    /* Leave the timer alone; if it was armed for this event, it will
+     * just find nothing due and move on to the next one
+     */
+    present_timeline_abort(&screen_priv->fake_timeline, event_id);
 }
 
 int
@@ -90,30 +121,25 @@ present_fake_queue_vblank(ScreenPtr     screen,
                           uint64_t      msc)
 {
     present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
-    uint64_t                    ust = msc * screen_priv->fake_interval;
-    uint64_t                    now = GetTimeInMicros();
-    INT32                       delay = ((int64_t) (ust - now)) / 1000;
-    present_fake_vblank_ptr     fake_vblank;
+    present_timeline_ptr        timeline = &screen_priv->fake_timeline;
+    uint64_t                    first;
+    Bool                        rearm;
 
-    if (delay <= 0) {
+    if (msc <= present_fake_due_msc(screen_priv, GetTimeInMicros())) {
         present_fake_notify(screen, event_id);
         return Success;
     }
 
-    fake_vblank = calloc (1, sizeof (present_fake_vblank_rec));
-    if (!fake_vblank)
+    rearm = !present_timeline_first(timeline, &first) || msc < first;
+
+    if (!present_timeline_queue(timeline, event_id, msc))
         return BadAlloc;
 
-    fake_vblank->screen = screen;
-    fake_vblank->event_id = event_id;
-    fake_vblank->timer = TimerSet(NULL, 0, delay, present_fake_do_timer, fake_vblank);
-    if (!fake_vblank->timer) {
-        free(fake_vblank);
+    if (rearm && !present_fake_arm_timer(screen)) {
+        present_timeline_abort(timeline, event_id);
         return BadAlloc;
     }
 
-    xorg_list_add(&fake_vblank->list, &fake_vblank_queue);
-
     return Success;
 }
 
@@ -132,10 +158,17 @@ present_fake_screen_init(ScreenPtr screen)
         screen_priv->fake_interval = 1000000;
     else
         screen_priv->fake_interval = 16667;
+
+    present_timeline_init(&screen_priv->fake_timeline);
+    screen_priv->fake_timer = NULL;
 }
 
 void
-present_fake_queue_init(void)
+present_fake_screen_fini(ScreenPtr screen)
 {
-    xorg_list_init(&fake_vblank_queue);
+    present_screen_priv_ptr screen_priv = present_screen_priv(screen);
+
+    TimerFree(screen_priv->fake_timer);
+    screen_priv->fake_timer = NULL;
+    present_timeline_fini(&screen_priv->fake_timeline);
 }
@@ -49,6 +49,41 @@ typedef struct present_fence *present_fence_ptr;
 
 typedef struct present_notify present_notify_rec, *present_notify_ptr;
 
+/*
+ * Why a pixmap presentation was copied instead of flipped
+ */
+typedef enum present_flip_reject {
+    PRESENT_FLIP_REJECT_NONE,           /* flip checks passed */
+    PRESENT_FLIP_REJECT_COPY_OPTION,    /* client asked for PresentOptionCopy */
+    PRESENT_FLIP_REJECT_UNSUPPORTED,    /* no CRTC or no driver flip support */
+    PRESENT_FLIP_REJECT_NO_ASYNC,       /* too late for a sync flip, no async flips */
+    PRESENT_FLIP_REJECT_REDIRECTED,     /* window is redirected */
+    PRESENT_FLIP_REJECT_CLIP,           /* window doesn't cover the screen */
+    PRESENT_FLIP_REJECT_OFFSET,         /* pixmap offset or partial valid region */
+    PRESENT_FLIP_REJECT_SIZE,           /* pixmap doesn't match the window */
+    PRESENT_FLIP_REJECT_DRIVER,         /* driver check_flip refused */
+    PRESENT_FLIP_REJECT_FORMAT,         /* driver refused the buffer format */
+    PRESENT_FLIP_REJECT_FAILED,         /* the flip itself failed */
+    PRESENT_FLIP_REJECT_COUNT
+} present_flip_reject;
+
+/* Lateness histogram, in frames past the target MSC: 0, 1, 2-3, 4-7, 8-15, 16+ */
+#define PRESENT_LATE_BUCKETS    6
+
+typedef struct present_stats {
+    uint64_t            completed[4];   /* pixmap presentations by PresentCompleteMode */
+    uint64_t            rejected[PRESENT_FLIP_REJECT_COUNT];    /* copies, by reason */
+    uint64_t            late[PRESENT_LATE_BUCKETS];
+    uint64_t            late_frames;    /* frames past target, summed */
+    uint64_t            max_late;
+} present_stats_rec, *present_stats_ptr;
+
+typedef struct present_crtc_stats {
+    RRCrtcPtr           crtc;           /* NULL for the fake CRTC */
+    RRCrtc              id;             /* the CRTC may be gone by the time we log */
+    present_stats_rec   stats;
+} present_crtc_stats_rec, *present_crtc_stats_ptr;
+
 struct present_notify {
     struct xorg_list    window_list;
     WindowPtr           window;
@@ -83,9 +118,40 @@ struct present_vblank {
     Bool                sync_flip;      /* do flip synchronous to vblank */
     Bool                abort_flip;     /* aborting this flip */
     PresentFlipReason   reason;         /* reason for which flip is not possible */
+    present_flip_reject reject;         /* why it will be copied, for the statistics */
     Bool                has_suboptimal; /* whether client can support SuboptimalCopy mode */
 };
 
+/*
+ * Pending events by id (present_timeline.c)
+ */
+typedef struct present_event_index_entry {
+    uint64_t            event_id;       /* 0 for an empty slot */
+    void                *data;
+} present_event_index_entry_rec, *present_event_index_entry_ptr;
+
+typedef struct present_event_index {
+    present_event_index_entry_ptr entries;
+    int                 num;
+    int                 bits;           /* 1 << bits slots */
+} present_event_index_rec, *present_event_index_ptr;
+
+/*
+ * Pending events for one CRTC in target MSC order (present_timeline.c)
+ */
+typedef struct present_timeline_event {
+    uint64_t            event_id;
+    uint64_t            msc;
+    int                 pos;            /* index in the heap */
+} present_timeline_event_rec, *present_timeline_event_ptr;
+
+typedef struct present_timeline {
+    present_timeline_event_ptr  *heap;
+    int                         num;
+    int                         size;
+    present_event_index_rec     index;
+} present_timeline_rec, *present_timeline_ptr;
+
 typedef struct present_screen_priv present_screen_priv_rec, *present_screen_priv_ptr;
 typedef struct present_window_priv present_window_priv_rec, *present_window_priv_ptr;
 
@@ -152,6 +218,11 @@ struct present_screen_priv {
     uint64_t                    unflip_event_id;
 
     uint32_t                    fake_interval;
+    present_timeline_rec        fake_timeline;
+    OsTimerPtr                  fake_timer;
+
+    present_crtc_stats_ptr      crtc_stats;
+    int                         num_crtc_stats;
 
     /* Currently active flipped pixmap and fence */
     RRCrtcPtr                   flip_crtc;
@@ -228,6 +299,9 @@ struct present_window_priv {
 
     present_vblank_ptr     flip_pending;
     present_vblank_ptr     flip_active;
+
+    present_stats_rec      stats;
+    present_flip_reject    flip_reject; /* why check_flip last refused */
 };
 
 #define PresentCrtcNeverSet     ((RRCrtcPtr) 1)
@@ -363,7 +437,7 @@ void
 present_fake_screen_init(ScreenPtr screen);
 
 void
-present_fake_queue_init(void);
+present_fake_screen_fini(ScreenPtr screen);
 
 /*
  * present_fence.c
@@ -447,6 +521,63 @@ present_scmd_init_mode_hooks(present_screen_priv_ptr screen_priv);
  * present_screen.c
  */
 
+/*
+ * present_stats.c
+ */
+Bool
+present_flip_rejected(WindowPtr window, present_flip_reject why);
+
+present_stats_ptr
+present_crtc_stats(ScreenPtr screen, RRCrtcPtr crtc, Bool create);
+
+void
+present_stats_record(present_vblank_ptr vblank, CARD8 mode, uint64_t crtc_msc);
+
+void
+present_stats_log_window(WindowPtr window);
+
+void
+present_stats_screen_init(ScreenPtr screen);
+
+void
+present_stats_screen_fini(ScreenPtr screen);
+
+/*
+ * present_timeline.c
+ */
+void
+present_event_index_init(present_event_index_ptr index);
+
+void
+present_event_index_fini(present_event_index_ptr index);
+
+Bool
+present_event_index_add(present_event_index_ptr index, uint64_t event_id, void *data);
+
+void *
+present_event_index_find(present_event_index_ptr index, uint64_t event_id);
+
+void *
+present_event_index_remove(present_event_index_ptr index, uint64_t event_id);
+
+void
+present_timeline_init(present_timeline_ptr timeline);
+
+void
+present_timeline_fini(present_timeline_ptr timeline);
+
+Bool
+present_timeline_queue(present_timeline_ptr timeline, uint64_t event_id, uint64_t msc);
+
+Bool
+present_timeline_abort(present_timeline_ptr timeline, uint64_t event_id);
+
+Bool
+present_timeline_first(present_timeline_ptr timeline, uint64_t *msc);
+
+Bool
+present_timeline_retire(present_timeline_ptr timeline, uint64_t msc, uint64_t *event_id);
+
 /*
  * present_vblank.c
  */
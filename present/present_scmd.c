@@ -43,6 +43,9 @@ static uint64_t         present_event_id;
 static struct xorg_list present_exec_queue;
 static struct xorg_list present_flip_queue;
 
+/* Everything on present_exec_queue and present_flip_queue, by event id */
+static present_event_index_rec present_event_index;
+
 static void
 present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc);
 
@@ -86,38 +89,38 @@ present_check_flip(RRCrtcPtr            crtc,
         *reason = PRESENT_FLIP_REASON_UNKNOWN;
 
     if (!screen_priv)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     if (!screen_priv->info)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     if (!crtc)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     /* Check to see if the driver supports flips at all */
     if (!screen_priv->info->flip)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     /* Make sure the window hasn't been redirected with Composite */
     window_pixmap = screen->GetWindowPixmap(window);
     if (window_pixmap != screen->GetScreenPixmap(screen) &&
         window_pixmap != screen_priv->flip_pixmap &&
         window_pixmap != present_flip_pending_pixmap(screen))
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_REDIRECTED);
 
     /* Check for full-screen window */
     if (!RegionEqual(&window->clipList, &root->winSize)) {
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_CLIP);
     }
 
     /* Source pixmap must align with window exactly */
     if (x_off || y_off) {
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_OFFSET);
     }
 
     /* Make sure the area marked as valid fills the screen */
     if (valid && !RegionEqual(valid, &root->winSize)) {
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_OFFSET);
     }
 
     /* Does the window match the pixmap exactly? */
@@ -127,19 +130,21 @@ present_check_flip(RRCrtcPtr            crtc,
 #endif
         window->drawable.width != pixmap->drawable.width ||
         window->drawable.height != pixmap->drawable.height) {
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_SIZE);
     }
 
     /* Ask the driver for permission */
     if (screen_priv->info->version >= 1 && screen_priv->info->check_flip2) {
         if (!(*screen_priv->info->check_flip2) (crtc, window, pixmap, sync_flip, reason)) {
             DebugPresent(("\td %08lx -> %08lx\n", window->drawable.id, pixmap ? pixmap->drawable.id : 0));
-            return FALSE;
+            return present_flip_rejected(window,
+                                         reason && *reason == PRESENT_FLIP_REASON_BUFFER_FORMAT ?
+                                         PRESENT_FLIP_REJECT_FORMAT : PRESENT_FLIP_REJECT_DRIVER);
         }
     } else if (screen_priv->info->check_flip) {
         if (!(*screen_priv->info->check_flip) (crtc, window, pixmap, sync_flip)) {
             DebugPresent(("\td %08lx -> %08lx\n", window->drawable.id, pixmap ? pixmap->drawable.id : 0));
-            return FALSE;
+            return present_flip_rejected(window, PRESENT_FLIP_REJECT_DRIVER);
         }
     }
 
@@ -371,6 +376,7 @@ present_flip_notify(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
     present_flip_idle(screen);
 
     xorg_list_del(&vblank->event_queue);
+    present_event_index_remove(&present_event_index, vblank->event_id);
 
     /* Transfer reference for pixmap and fence from vblank to screen_priv */
     screen_priv->flip_crtc = vblank->crtc;
@@ -403,21 +409,17 @@ present_event_notify(uint64_t event_id, uint64_t ust, uint64_t msc)
     if (!event_id)
         return;
     DebugPresent(("\te %lld ust %lld msc %lld\n", event_id, ust, msc));
-    xorg_list_for_each_entry(vblank, &present_exec_queue, event_queue) {
-        int64_t match = event_id - vblank->event_id;
-        if (match == 0) {
+    vblank = present_event_index_find(&present_event_index, event_id);
+    if (vblank) {
+        /* Everything on the exec queue, and flips waiting for a previous
+         * one to finish, are still queued; the rest of the flip queue has
+         * been handed to the driver
+         */
+        if (vblank->queued)
             present_execute(vblank, ust, msc);
-            return;
-        }
-    }
-    xorg_list_for_each_entry(vblank, &present_flip_queue, event_queue) {
-        if (vblank->event_id == event_id) {
-            if (vblank->queued)
-                present_execute(vblank, ust, msc);
-            else
-                present_flip_notify(vblank, ust, msc);
-            return;
-        }
+        else
+            present_flip_notify(vblank, ust, msc);
+        return;
     }
 
     for (s = 0; s < screenInfo.numScreens; s++) {
@@ -481,6 +483,7 @@ present_check_flip_window (WindowPtr window)
         if (vblank->queued && vblank->flip && !present_check_flip(vblank->crtc, window, vblank->pixmap, vblank->sync_flip, NULL, 0, 0, &reason)) {
             vblank->flip = FALSE;
             vblank->reason = reason;
+            vblank->reject = window_priv->flip_reject;
             if (vblank->sync_flip)
                 vblank->requeue = TRUE;
         }
@@ -558,6 +561,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
     }
 
     xorg_list_del(&vblank->event_queue);
+    present_event_index_remove(&present_event_index, vblank->event_id);
     xorg_list_del(&vblank->window_list);
     vblank->queued = FALSE;
 
@@ -575,6 +579,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
             screen_priv->flip_pending = vblank;
 
             xorg_list_add(&vblank->event_queue, &present_flip_queue);
+            (void) present_event_index_add(&present_event_index, vblank->event_id, vblank);
             /* Try to flip
              */
             if (present_flip(vblank->crtc, vblank->event_id, vblank->target_msc, vblank->pixmap, vblank->sync_flip)) {
@@ -604,10 +609,12 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
             }
 
             xorg_list_del(&vblank->event_queue);
+            present_event_index_remove(&present_event_index, vblank->event_id);
             /* Oops, flip failed. Clear the flip_pending field
               */
             screen_priv->flip_pending = NULL;
             vblank->flip = FALSE;
+            vblank->reject = PRESENT_FLIP_REJECT_FAILED;
         }
         DebugPresent(("\tc %p %8lld: %08lx -> %08lx\n", vblank, crtc_msc, vblank->pixmap->drawable.id, vblank->window->drawable.id));
         if (screen_priv->flip_pending) {
@@ -628,6 +635,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
 
         if (vblank->queued) {
             xorg_list_add(&vblank->event_queue, &present_exec_queue);
+            (void) present_event_index_add(&present_event_index, vblank->event_id, vblank);
             xorg_list_append(&vblank->window_list,
                              &present_get_window_priv(window, TRUE)->vblank);
             return;
@@ -752,7 +760,11 @@ present_scmd_pixmap(WindowPtr window,
 
     xorg_list_append(&vblank->event_queue, &present_exec_queue);
     vblank->queued = TRUE;
-    if (msc_is_after(target_msc, crtc_msc)) {
+    /* Without an index entry its vblank event could not be matched up,
+     * so execute it right away instead
+     */
+    if (present_event_index_add(&present_event_index, vblank->event_id, vblank) &&
+        msc_is_after(target_msc, crtc_msc)) {
         ret = present_queue_vblank(screen, window, target_crtc, vblank->event_id, target_msc);
         if (ret == Success)
             return Success;
@@ -779,20 +791,10 @@ present_scmd_abort_vblank(ScreenPtr screen, WindowPtr window, RRCrtcPtr crtc, ui
         (*screen_priv->info->abort_vblank) (crtc, event_id, msc);
     }
 
-    xorg_list_for_each_entry(vblank, &present_exec_queue, event_queue) {
-        int64_t match = event_id - vblank->event_id;
-        if (match == 0) {
-            xorg_list_del(&vblank->event_queue);
-            vblank->queued = FALSE;
-            return;
-        }
-    }
-    xorg_list_for_each_entry(vblank, &present_flip_queue, event_queue) {
-        if (vblank->event_id == event_id) {
-            xorg_list_del(&vblank->event_queue);
-            vblank->queued = FALSE;
-            return;
-        }
+    vblank = present_event_index_remove(&present_event_index, event_id);
+    if (vblank) {
+        xorg_list_del(&vblank->event_queue);
+        vblank->queued = FALSE;
     }
 }
 
@@ -835,6 +837,6 @@ present_init(void)
 {
     xorg_list_init(&present_exec_queue);
     xorg_list_init(&present_flip_queue);
-    present_fake_queue_init();
+    present_event_index_fini(&present_event_index);
     return TRUE;
 }
@@ -65,6 +65,8 @@ present_close_screen(ScreenPtr screen)
     present_screen_priv_ptr screen_priv = present_screen_priv(screen);
 
     screen_priv->flip_destroy(screen);
+    present_fake_screen_fini(screen);
+    present_stats_screen_fini(screen);
 
     unwrap(screen_priv, screen, CloseScreen);
     (*screen->CloseScreen) (screen);
@@ -150,6 +152,7 @@ present_destroy_window(WindowPtr window)
         present_clear_window_notifies(window);
         present_free_events(window);
         present_free_window_vblank(window);
+        present_stats_log_window(window);
 
         if (screen_priv->wnmd_info)
             present_wnmd_clear_window_flip(window);
@@ -235,6 +238,8 @@ present_screen_priv_init(ScreenPtr screen)
 
     dixSetPrivate(&screen->devPrivates, &present_screen_private_key, screen_priv);
 
+    present_stats_screen_init(screen);
+
     return screen_priv;
 }
 
@@ -0,0 +1,254 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Presentation statistics
+ *
+ * Every completed pixmap presentation is counted, per window and per
+ * CRTC, by how it completed (flip, copy, skip), how many frames past its
+ * target MSC it landed, and for copies, why it was not flipped. Window
+ * statistics are logged when a window that presented goes away, CRTC
+ * statistics when the screen closes. With -reqprof, SIGUSR2 logs them
+ * all for the windows and CRTCs still around.
+ */
+
+#ifdef HAVE_XORG_CONFIG_H
+#include <xorg-config.h>
+#endif
+
+#include "present_priv.h"
+#include "reqprof.h"
+
+static const char *present_flip_reject_names[PRESENT_FLIP_REJECT_COUNT] = {
+    [PRESENT_FLIP_REJECT_NONE] = "other",
+    [PRESENT_FLIP_REJECT_COPY_OPTION] = "copy option",
+    [PRESENT_FLIP_REJECT_UNSUPPORTED] = "unsupported",
+    [PRESENT_FLIP_REJECT_NO_ASYNC] = "no async",
+    [PRESENT_FLIP_REJECT_REDIRECTED] = "redirected",
+    [PRESENT_FLIP_REJECT_CLIP] = "clip",
+    [PRESENT_FLIP_REJECT_OFFSET] = "offset",
+    [PRESENT_FLIP_REJECT_SIZE] = "size",
+    [PRESENT_FLIP_REJECT_DRIVER] = "driver",
+    [PRESENT_FLIP_REJECT_FORMAT] = "format",
+    [PRESENT_FLIP_REJECT_FAILED] = "flip failed",
+};
+
+static const char *present_late_names[PRESENT_LATE_BUCKETS] = {
+    "0", "1", "2-3", "4-7", "8-15", "16+"
+};
+
+/*
+ * Note why check_flip refused 'window' and return FALSE, so the check
+ * functions can 'return present_flip_rejected(window, why);'
+ */
+Bool
+present_flip_rejected(WindowPtr window, present_flip_reject why)
+{
+    present_window_priv_ptr window_priv = present_window_priv(window);
+
+    if (window_priv)
+        window_priv->flip_reject = why;
+    return FALSE;
+}
+
+present_stats_ptr
+present_crtc_stats(ScreenPtr screen, RRCrtcPtr crtc, Bool create)
+{
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    present_crtc_stats_ptr      crtc_stats;
+    int                         i;
+
+    for (i = 0; i < screen_priv->num_crtc_stats; i++)
+        if (screen_priv->crtc_stats[i].crtc == crtc)
+            return &screen_priv->crtc_stats[i].stats;
+
+    if (!create)
+        return NULL;
+
+    crtc_stats = reallocarray(screen_priv->crtc_stats,
+                              screen_priv->num_crtc_stats + 1,
+                              sizeof (present_crtc_stats_rec));
+    if (!crtc_stats)
+        return NULL;
+    screen_priv->crtc_stats = crtc_stats;
+
+    crtc_stats += screen_priv->num_crtc_stats++;
+    memset(crtc_stats, 0, sizeof (*crtc_stats));
+    crtc_stats->crtc = crtc;
+    crtc_stats->id = crtc ? crtc->id : None;
+    return &crtc_stats->stats;
+}
+
+static void
+present_stats_add(present_stats_ptr stats, present_vblank_ptr vblank,
+                  CARD8 mode, uint64_t late)
+{
+    int bucket;
+
+    stats->completed[mode]++;
+    if (mode == PresentCompleteModeSkip)
+        return;
+
+    if (mode != PresentCompleteModeFlip)
+        stats->rejected[vblank->reject]++;
+
+    bucket = 0;
+    while (bucket < PRESENT_LATE_BUCKETS - 1 && late >= 1ULL << bucket)
+        bucket++;
+    stats->late[bucket]++;
+    stats->late_frames += late;
+    if (late > stats->max_late)
+        stats->max_late = late;
+}
+
+/*
+ * Called for every pixmap presentation as its completion is reported
+ */
+void
+present_stats_record(present_vblank_ptr vblank, CARD8 mode, uint64_t crtc_msc)
+{
+    present_window_priv_ptr     window_priv;
+    present_stats_ptr           stats;
+    uint64_t                    late = 0;
+
+    if (mode > PresentCompleteModeSuboptimalCopy)
+        return;
+
+    if (msc_is_after(crtc_msc, vblank->target_msc))
+        late = crtc_msc - vblank->target_msc;
+
+    if (vblank->window) {
+        window_priv = present_window_priv(vblank->window);
+        if (window_priv)
+            present_stats_add(&window_priv->stats, vblank, mode, late);
+    }
+
+    stats = present_crtc_stats(vblank->screen, vblank->crtc, TRUE);
+    if (stats)
+        present_stats_add(stats, vblank, mode, late);
+}
+
+static void
+present_stats_log(int verb, const char *what, XID id, present_stats_ptr stats)
+{
+    uint64_t    completed = 0, presented = 0;
+    char        line[512];
+    int         i, n;
+
+    for (i = 0; i < PresentCompleteModeSuboptimalCopy + 1; i++)
+        completed += stats->completed[i];
+    if (!completed)
+        return;
+    presented = completed - stats->completed[PresentCompleteModeSkip];
+
+    LogMessageVerb(X_INFO, verb,
+                   "present: %s 0x%x: %llu flips (%d%%), %llu copies, "
+                   "%llu suboptimal copies, %llu skipped\n", what,
+                   (unsigned int) id,
+                   (unsigned long long) stats->completed[PresentCompleteModeFlip],
+                   presented ? (int) (stats->completed[PresentCompleteModeFlip] * 100 / presented) : 0,
+                   (unsigned long long) stats->completed[PresentCompleteModeCopy],
+                   (unsigned long long) stats->completed[PresentCompleteModeSuboptimalCopy],
+                   (unsigned long long) stats->completed[PresentCompleteModeSkip]);
+
+    n = 0;
+    for (i = 0; i < PRESENT_LATE_BUCKETS; i++)
+        n += snprintf(line + n, sizeof (line) - n, " %s: %llu",
+                      present_late_names[i],
+                      (unsigned long long) stats->late[i]);
+    LogMessageVerb(X_INFO, verb,
+                   "present: %s 0x%x: frames late avg %.2f max %llu,%s\n",
+                   what, (unsigned int) id,
+                   presented ? (double) stats->late_frames / presented : 0.0,
+                   (unsigned long long) stats->max_late, line);
+
+    n = 0;
+    line[0] = '\0';
+    for (i = 0; i < PRESENT_FLIP_REJECT_COUNT; i++)
+        if (stats->rejected[i])
+            n += snprintf(line + n, sizeof (line) - n, " %s: %llu",
+                          present_flip_reject_names[i],
+                          (unsigned long long) stats->rejected[i]);
+    if (n)
+        LogMessageVerb(X_INFO, verb, "present: %s 0x%x: copied because%s\n",
+                       what, (unsigned int) id, line);
+}
+
+void
+present_stats_log_window(WindowPtr window)
+{
+    present_window_priv_ptr window_priv = present_window_priv(window);
+
+    if (window_priv)
+        present_stats_log(4, "window", window->drawable.id, &window_priv->stats);
+}
+
+static int
+present_stats_dump_window(WindowPtr window, void *data)
+{
+    present_window_priv_ptr window_priv = present_window_priv(window);
+
+    if (window_priv)
+        present_stats_log(1, "window", window->drawable.id, &window_priv->stats);
+    return WT_WALKCHILDREN;
+}
+
+/*
+ * Log everything counted on this screen so far, following the request
+ * profile on SIGUSR2
+ */
+static void
+present_stats_dump(CallbackListPtr *pcbl, void *closure, void *data)
+{
+    ScreenPtr                   screen = closure;
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    int                         i;
+
+    for (i = 0; i < screen_priv->num_crtc_stats; i++)
+        present_stats_log(1, "CRTC", screen_priv->crtc_stats[i].id,
+                          &screen_priv->crtc_stats[i].stats);
+
+    if (screen->root)
+        TraverseTree(screen->root, present_stats_dump_window, NULL);
+}
+
+void
+present_stats_screen_init(ScreenPtr screen)
+{
+    AddCallback(&RequestProfileDumpCallback, present_stats_dump, screen);
+}
+
+void
+present_stats_screen_fini(ScreenPtr screen)
+{
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    int                         i;
+
+    DeleteCallback(&RequestProfileDumpCallback, present_stats_dump, screen);
+
+    for (i = 0; i < screen_priv->num_crtc_stats; i++)
+        present_stats_log(3, "CRTC", screen_priv->crtc_stats[i].id,
+                          &screen_priv->crtc_stats[i].stats);
+
+    free(screen_priv->crtc_stats);
+    screen_priv->crtc_stats = NULL;
+    screen_priv->num_crtc_stats = 0;
+}
@@ -0,0 +1,357 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_XORG_CONFIG_H
+#include <xorg-config.h>
+#endif
+
+#include "present_priv.h"
+
+/*
+ * Event index
+ *
+ * Maps event ids to pending vblanks so that present_event_notify and
+ * the abort paths don't have to walk every queued presentation. Open
+ * addressing with linear probing; event id 0 is never handed out and
+ * marks an empty slot.
+ */
+
+#define PRESENT_EVENT_INDEX_MIN_BITS    6
+
+static inline uint32_t
+present_event_index_hash(present_event_index_ptr index, uint64_t event_id)
+{
+    /* event ids are sequential, so spread them with a multiplicative hash */
+    return (event_id * 0x9e3779b97f4a7c15ULL) >> (64 - index->bits);
+}
+
+static Bool
+present_event_index_resize(present_event_index_ptr index, int bits)
+{
+    present_event_index_entry_ptr old = index->entries;
+    int old_size = index->entries ? 1 << index->bits : 0;
+    int i;
+
+    index->entries = calloc(1 << bits, sizeof (present_event_index_entry_rec));
+    if (!index->entries) {
+        index->entries = old;
+        return FALSE;
+    }
+    index->bits = bits;
+
+    for (i = 0; i < old_size; i++) {
+        uint32_t mask = (1 << bits) - 1;
+        uint32_t h;
+
+        if (!old[i].event_id)
+            continue;
+        for (h = present_event_index_hash(index, old[i].event_id);
+             index->entries[h].event_id;
+             h = (h + 1) & mask)
+            ;
+        index->entries[h] = old[i];
+    }
+    free(old);
+    return TRUE;
+}
+
+void
+present_event_index_init(present_event_index_ptr index)
+{
+    index->entries = NULL;
+    index->num = 0;
+    index->bits = 0;
+}
+
+void
+present_event_index_fini(present_event_index_ptr index)
+{
+    free(index->entries);
+    present_event_index_init(index);
+}
+
+/*
+ * Adding can only fail when the table is full and cannot grow, so
+ * re-adding an event right after removing it always succeeds.
+ */
+Bool
+present_event_index_add(present_event_index_ptr index, uint64_t event_id,
+                        void *data)
+{
+    uint32_t mask, h;
+
+    if (!index->entries) {
+        if (!present_event_index_resize(index, PRESENT_EVENT_INDEX_MIN_BITS))
+            return FALSE;
+    }
+    else if ((index->num + 1) * 2 > 1 << index->bits) {
+        if (!present_event_index_resize(index, index->bits + 1) &&
+            index->num + 1 >= 1 << index->bits)
+            return FALSE;
+    }
+
+    mask = (1 << index->bits) - 1;
+    for (h = present_event_index_hash(index, event_id);
+         index->entries[h].event_id;
+         h = (h + 1) & mask)
+        ;
+    index->entries[h].event_id = event_id;
+    index->entries[h].data = data;
+    index->num++;
+    return TRUE;
+}
+
+void *
+present_event_index_find(present_event_index_ptr index, uint64_t event_id)
+{
+    uint32_t mask, h;
+
+    if (!index->num || !event_id)
+        return NULL;
+
+    mask = (1 << index->bits) - 1;
+    for (h = present_event_index_hash(index, event_id);
+         index->entries[h].event_id;
+         h = (h + 1) & mask)
+        if (index->entries[h].event_id == event_id)
+            return index->entries[h].data;
+    return NULL;
+}
+
+void *
+present_event_index_remove(present_event_index_ptr index, uint64_t event_id)
+{
+    present_event_index_entry_ptr entries = index->entries;
+    uint32_t mask, h, next;
+    void *data;
+
+    if (!index->num || !event_id)
+        return NULL;
+
+    mask = (1 << index->bits) - 1;
+    for (h = present_event_index_hash(index, event_id);
+         entries[h].event_id != event_id;
+         h = (h + 1) & mask)
+        if (!entries[h].event_id)
+            return NULL;
+
+    data = entries[h].data;
+    index->num--;
+
+    /* Shift later members of the probe sequence back into the hole */
+    for (next = (h + 1) & mask; entries[next].event_id; next = (next + 1) & mask) {
+        uint32_t home = present_event_index_hash(index, entries[next].event_id);
+
+        if (((next - home) & mask) >= ((next - h) & mask)) {
+            entries[h] = entries[next];
+            h = next;
+        }
+    }
+    entries[h].event_id = 0;
+    entries[h].data = NULL;
+    return data;
+}
+
+/*
+ * Timeline
+ *
+ * Pending vblank events for one CRTC, kept in a binary heap ordered by
+ * target MSC (ties broken by event id, so events for the same frame are
+ * delivered in the order they were queued). Together with the event
+ * index this makes queueing, aborting and retiring the next event all
+ * O(log n).
+ */
+
+static inline Bool
+present_timeline_before(present_timeline_event_ptr a,
+                        present_timeline_event_ptr b)
+{
+    if (a->msc != b->msc)
+        return a->msc < b->msc;
+    return a->event_id < b->event_id;
+}
+
+static inline void
+present_timeline_set(present_timeline_ptr timeline, int pos,
+                     present_timeline_event_ptr event)
+{
+    timeline->heap[pos] = event;
+    event->pos = pos;
+}
+
+static void
+present_timeline_sift_up(present_timeline_ptr timeline, int pos)
+{
+    present_timeline_event_ptr event = timeline->heap[pos];
+
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+
+        if (!present_timeline_before(event, timeline->heap[parent]))
+            break;
+        present_timeline_set(timeline, pos, timeline->heap[parent]);
+        pos = parent;
+    }
+    present_timeline_set(timeline, pos, event);
+}
+
+static void
+present_timeline_sift_down(present_timeline_ptr timeline, int pos)
+{
+    present_timeline_event_ptr event = timeline->heap[pos];
+
+    for (;;) {
+        int child = pos * 2 + 1;
+
+        if (child >= timeline->num)
+            break;
+        if (child + 1 < timeline->num &&
+            present_timeline_before(timeline->heap[child + 1],
+                                    timeline->heap[child]))
+            child++;
+        if (!present_timeline_before(timeline->heap[child], event))
+            break;
+        present_timeline_set(timeline, pos, timeline->heap[child]);
+        pos = child;
+    }
+    present_timeline_set(timeline, pos, event);
+}
+
+void
+present_timeline_init(present_timeline_ptr timeline)
+{
+    timeline->heap = NULL;
+    timeline->num = 0;
+    timeline->size = 0;
+    present_event_index_init(&timeline->index);
+}
+
+void
+present_timeline_fini(present_timeline_ptr timeline)
+{
+    int i;
+
+    for (i = 0; i < timeline->num; i++)
+        free(timeline->heap[i]);
+    free(timeline->heap);
+    present_event_index_fini(&timeline->index);
+    present_timeline_init(timeline);
+}
+
+/*
+ * Queue 'event_id' for 'msc'. Returns FALSE on allocation failure.
+ */
+Bool
+present_timeline_queue(present_timeline_ptr timeline, uint64_t event_id,
+                       uint64_t msc)
+{
+    present_timeline_event_ptr event;
+
+    if (timeline->num == timeline->size) {
+        int size = timeline->size ? timeline->size * 2 : 16;
+        present_timeline_event_ptr *heap;
+
+        heap = reallocarray(timeline->heap, size, sizeof (*heap));
+        if (!heap)
+            return FALSE;
+        timeline->heap = heap;
+        timeline->size = size;
+    }
+
+    event = malloc(sizeof (present_timeline_event_rec));
+    if (!event)
+        return FALSE;
+    event->event_id = event_id;
+    event->msc = msc;
+
+    if (!present_event_index_add(&timeline->index, event_id, event)) {
+        free(event);
+        return FALSE;
+    }
+
+    present_timeline_set(timeline, timeline->num++, event);
+    present_timeline_sift_up(timeline, event->pos);
+    return TRUE;
+}
+
+static void
+present_timeline_remove(present_timeline_ptr timeline,
+                        present_timeline_event_ptr event)
+{
+    int pos = event->pos;
+
+    present_event_index_remove(&timeline->index, event->event_id);
+    if (pos != --timeline->num) {
+        present_timeline_event_ptr last = timeline->heap[timeline->num];
+
+        present_timeline_set(timeline, pos, last);
+        if (pos > 0 &&
+            present_timeline_before(last, timeline->heap[(pos - 1) / 2]))
+            present_timeline_sift_up(timeline, pos);
+        else
+            present_timeline_sift_down(timeline, pos);
+    }
+    free(event);
+}
+
+/*
+ * Drop 'event_id' from the timeline. Returns FALSE if it wasn't queued.
+ */
+Bool
+present_timeline_abort(present_timeline_ptr timeline, uint64_t event_id)
+{
+    present_timeline_event_ptr event;
+
+    event = present_event_index_find(&timeline->index, event_id);
+    if (!event)
+        return FALSE;
+    present_timeline_remove(timeline, event);
+    return TRUE;
+}
+
+/*
+ * Report the MSC of the earliest event without removing it.
+ */
+Bool
+present_timeline_first(present_timeline_ptr timeline, uint64_t *msc)
+{
+    if (!timeline->num)
+        return FALSE;
+    *msc = timeline->heap[0]->msc;
+    return TRUE;
+}
+
+/*
+ * Remove and return the earliest event if its MSC is not after 'msc'.
+ */
+Bool
+present_timeline_retire(present_timeline_ptr timeline, uint64_t msc,
+                        uint64_t *event_id)
+{
+    present_timeline_event_ptr event;
+
+    if (!timeline->num || timeline->heap[0]->msc > msc)
+        return FALSE;
+    event = timeline->heap[0];
+    *event_id = event->event_id;
+    present_timeline_remove(timeline, event);
+    return TRUE;
+}
@@ -31,6 +31,9 @@ present_vblank_notify(present_vblank_ptr vblank, CARD8 kind, CARD8 mode, uint64_
 {
     int n;
 
+    if (kind == PresentCompleteKindPixmap)
+        present_stats_record(vblank, mode, crtc_msc);
+
     if (vblank->window)
         present_send_complete_notify(vblank->window, kind, mode, vblank->serial, ust, crtc_msc - vblank->msc_offset);
     for (n = 0; n < vblank->num_notifies; n++) {
@@ -108,9 +111,15 @@ present_vblank_create(WindowPtr window,
     vblank->has_suboptimal = (options & PresentOptionSuboptimal);
     vblank->flip_idler = FALSE;
 
+    if (options & PresentOptionCopy)
+        vblank->reject = PRESENT_FLIP_REJECT_COPY_OPTION;
+    else if (!capabilities)
+        vblank->reject = PRESENT_FLIP_REJECT_UNSUPPORTED;
+
     if (pixmap != NULL &&
         !(options & PresentOptionCopy) &&
         capabilities) {
+        window_priv->flip_reject = PRESENT_FLIP_REJECT_NO_ASYNC;
         if (msc_is_after(*target_msc, crtc_msc) &&
             screen_priv->check_flip (target_crtc, window, pixmap, TRUE, valid, x_off, y_off, &reason))
         {
@@ -122,6 +131,8 @@ present_vblank_create(WindowPtr window,
         {
             vblank->flip = TRUE;
         }
+        if (!vblank->flip)
+            vblank->reject = window_priv->flip_reject;
     }
     vblank->reason = reason;
 
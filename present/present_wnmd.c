@@ -257,42 +257,44 @@ present_wnmd_check_flip(RRCrtcPtr           crtc,
         *reason = PRESENT_FLIP_REASON_UNKNOWN;
 
     if (!screen_priv)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     if (!screen_priv->wnmd_info)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     if (!crtc)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     /* Check to see if the driver supports flips at all */
     if (!screen_priv->wnmd_info->flip)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_UNSUPPORTED);
 
     /* Don't flip redirected windows */
     if (window->redirectDraw != RedirectDrawNone)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_REDIRECTED);
 
     /* Source pixmap must align with window exactly */
     if (x_off || y_off)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_OFFSET);
 
     // TODO: Check for valid region?
 
     /* Flip pixmap must have same dimensions as window */
     if (window->drawable.width != pixmap->drawable.width ||
             window->drawable.height != pixmap->drawable.height)
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_SIZE);
 
     /* Window must be same region as toplevel window */
     if ( !RegionEqual(&window->winSize, &toplvl_window->winSize) )
-        return FALSE;
+        return present_flip_rejected(window, PRESENT_FLIP_REJECT_CLIP);
 
     /* Ask the driver for permission */
     if (screen_priv->wnmd_info->check_flip2) {
         if (!(*screen_priv->wnmd_info->check_flip2) (crtc, window, pixmap, sync_flip, reason)) {
             DebugPresent(("\td %08lx -> %08lx\n", window->drawable.id, pixmap ? pixmap->drawable.id : 0));
-            return FALSE;
+            return present_flip_rejected(window,
+                                         reason && *reason == PRESENT_FLIP_REASON_BUFFER_FORMAT ?
+                                         PRESENT_FLIP_REJECT_FORMAT : PRESENT_FLIP_REJECT_DRIVER);
         }
     }
 
@@ -338,6 +340,7 @@ present_wnmd_check_flip_window (WindowPtr window)
                                          vblank->sync_flip, NULL, 0, 0, &reason)) {
             vblank->flip = FALSE;
             vblank->reason = reason;
+            vblank->reject = window_priv->flip_reject;
             if (vblank->sync_flip)
                 vblank->requeue = TRUE;
         }
@@ -483,6 +486,7 @@ present_wnmd_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
               */
             window_priv->flip_pending = NULL;
             vblank->flip = FALSE;
+            vblank->reject = PRESENT_FLIP_REJECT_FAILED;
         }
         DebugPresent(("\tc %p %8lld: %08lx -> %08lx\n", vblank, crtc_msc, vblank->pixmap->drawable.id, vblank->window->drawable.id));
 
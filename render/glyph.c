@@ -466,6 +466,66 @@ AllocateGlyphSet(int fdepth, PictFormatPtr format)
     return glyphSet;
 }
 
+/* Memory used by a glyph and its pictures on all screens */
+static void
+GetGlyphBytes(GlyphPtr glyph, unsigned long *bytes, unsigned long *pixmapBytes)
+{
+    SizeType pixmapSizeFunc = GetResourceTypeSizeFunc(RT_PIXMAP);
+    int i;
+
+    *bytes = glyph->size;
+    *pixmapBytes = 0;
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        PicturePtr picture = GetGlyphPicture(glyph, screenInfo.screens[i]);
+
+        if (picture && picture->pDrawable) {
+            PixmapPtr pixmap = (PixmapPtr) picture->pDrawable;
+            ResourceSizeRec size = { 0, 0, 0 };
+
+            pixmapSizeFunc(pixmap, pixmap->drawable.id, &size);
+            *bytes += sizeof(PictureRec);
+            *pixmapBytes += size.pixmapRefSize;
+        }
+    }
+}
+
+/**
+ * Estimate the memory used by a glyph set for X-Resource.  Glyphs with
+ * the same image are shared by all the sets holding them, so each set is
+ * charged the glyph's size divided by the number of references to it.
+ * Glyph pictures count as pixmap references of the set.
+ *
+ * @param[in] value Pointer to a glyph set.
+ *
+ * @param[in] id    Resource ID of the glyph set.
+ *
+ * @param[out] size Estimate of memory usage attributed to the glyph set.
+ */
+void
+GetGlyphSetBytes(void *value, XID id, ResourceSizePtr size)
+{
+    GlyphSetPtr glyphSet = value;
+    GlyphRefPtr table = glyphSet->hash.table;
+    unsigned long bytes, pixmapBytes;
+    CARD32 i;
+
+    size->resourceSize = sizeof(GlyphSetRec) +
+        glyphSet->hash.hashSet->size * sizeof(GlyphRefRec);
+    size->pixmapRefSize = 0;
+    size->refCnt = glyphSet->refcnt;
+
+    for (i = 0; i < glyphSet->hash.hashSet->size; i++) {
+        GlyphPtr glyph = table[i].glyph;
+
+        if (!glyph || glyph == DeletedGlyph)
+            continue;
+
+        GetGlyphBytes(glyph, &bytes, &pixmapBytes);
+        size->resourceSize += (bytes + pixmapBytes) / glyph->refcnt;
+        size->pixmapRefSize += pixmapBytes / glyph->refcnt;
+    }
+}
+
 int
 FreeGlyphSet(void *value, XID gid)
 {
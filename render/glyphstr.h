@@ -117,6 +117,9 @@ extern GlyphSetPtr AllocateGlyphSet(int fdepth, PictFormatPtr format);
 extern int
  FreeGlyphSet(void *value, XID gid);
 
+extern void
+ GetGlyphSetBytes(void *value, XID id, ResourceSizePtr size);
+
 #define GLYPH_HAS_GLYPH_PICTURE_ACCESSOR 1 /* used for api compat */
 extern _X_EXPORT PicturePtr
  GetGlyphPicture(GlyphPtr glyph, ScreenPtr pScreen);
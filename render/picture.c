@@ -52,6 +52,7 @@ RESTYPE PictureType;
 RESTYPE PictFormatType;
 RESTYPE GlyphSetType;
 int PictureCmapPolicy = PictureCmapPolicyDefault;
+int PictureRenderThreads = 0;
 
 PictFormatPtr
 PictureWindowFormat(WindowPtr pWindow)
@@ -625,6 +626,7 @@ PictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
         GlyphSetType = CreateNewResourceType(FreeGlyphSet, "GLYPHSET");
         if (!GlyphSetType)
             return FALSE;
+        SetResourceTypeSizeFunc(GlyphSetType, GetGlyphSetBytes);
         PictureGeneration = serverGeneration;
     }
     if (!dixRegisterPrivateKey(&PictureScreenPrivateKeyRec, PRIVATE_SCREEN, 0))
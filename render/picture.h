@@ -171,6 +171,9 @@ typedef enum _PictFormatShort {
 
 extern int PictureCmapPolicy;
 
+/* threads used for large software composites, see -renderthreads */
+extern _X_EXPORT int PictureRenderThreads;
+
 extern int PictureParseCmapPolicy(const char *name);
 
 extern int RenderErrBase;
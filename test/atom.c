@@ -0,0 +1,132 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the atom table in dix/atom.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+
+#include "tests-common.h"
+
+static void
+atom_predefined(void)
+{
+    InitAtoms();
+
+    assert(MakeAtom("PRIMARY", strlen("PRIMARY"), FALSE) == XA_PRIMARY);
+    assert(MakeAtom("WM_TRANSIENT_FOR", strlen("WM_TRANSIENT_FOR"),
+                    FALSE) == XA_WM_TRANSIENT_FOR);
+    assert(strcmp(NameForAtom(XA_STRING), "STRING") == 0);
+    assert(ValidAtom(XA_LAST_PREDEFINED));
+    assert(!ValidAtom(None));
+    assert(!ValidAtom(XA_LAST_PREDEFINED + 1));
+    assert(NameForAtom(None) == NULL);
+    assert(NameForAtom(XA_LAST_PREDEFINED + 1) == NULL);
+}
+
+static void
+atom_intern(void)
+{
+    Atom a, b, c;
+
+    InitAtoms();
+
+    assert(MakeAtom("_NET_WM_NAME", 12, FALSE) == None);
+    a = MakeAtom("_NET_WM_NAME", 12, TRUE);
+    assert(a == XA_LAST_PREDEFINED + 1);
+    assert(MakeAtom("_NET_WM_NAME", 12, FALSE) == a);
+    assert(MakeAtom("_NET_WM_NAME", 12, TRUE) == a);
+
+    /* prefixes of an existing name are distinct atoms */
+    assert(MakeAtom("_NET_WM_NAME", 11, FALSE) == None);
+    b = MakeAtom("_NET_WM_NAME", 11, TRUE);
+    assert(b != a);
+    assert(strcmp(NameForAtom(b), "_NET_WM_NAM") == 0);
+
+    /* the name is copied, not referenced */
+    {
+        char buf[] = "UTF8_STRING";
+
+        c = MakeAtom(buf, strlen(buf), TRUE);
+        buf[0] = 'X';
+        assert(strcmp(NameForAtom(c), "UTF8_STRING") == 0);
+    }
+
+    /* names longer than an arena chunk */
+    {
+        static char big[100000];
+
+        memset(big, 'A', sizeof(big) - 1);
+        c = MakeAtom(big, sizeof(big) - 1, TRUE);
+        assert(c != BAD_RESOURCE);
+        assert(strlen(NameForAtom(c)) == sizeof(big) - 1);
+        assert(MakeAtom(big, sizeof(big) - 1, FALSE) == c);
+        assert(MakeAtom("_NET_WM_NAME", 12, FALSE) == a);
+    }
+
+    FreeAllAtoms();
+    assert(!ValidAtom(XA_PRIMARY));
+}
+
+static void
+atom_many(void)
+{
+    char name[32];
+    int i;
+
+    InitAtoms();
+
+    /* enough atoms to grow the table several times */
+    for (i = 0; i < 10000; i++) {
+        int len = snprintf(name, sizeof(name), "_MANY_ATOM_%d", i);
+
+        assert(MakeAtom(name, len, TRUE) == XA_LAST_PREDEFINED + 1 + i);
+    }
+    for (i = 0; i < 10000; i++) {
+        int len = snprintf(name, sizeof(name), "_MANY_ATOM_%d", i);
+
+        assert(MakeAtom(name, len, FALSE) == XA_LAST_PREDEFINED + 1 + i);
+        assert(strcmp(NameForAtom(XA_LAST_PREDEFINED + 1 + i), name) == 0);
+    }
+    assert(MakeAtom("PRIMARY", strlen("PRIMARY"), FALSE) == XA_PRIMARY);
+
+    FreeAllAtoms();
+}
+
+int
+atom_test(void)
+{
+    atom_predefined();
+    atom_intern();
+    atom_many();
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * InternAtom and GetAtomName throughput on a large atom table.
+ *
+ * Interns a few hundred thousand new atoms, looks each of them up again
+ * by name, then fetches every name back by atom, pipelining the requests
+ * in batches.  Prints the time taken per request for each pass.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_ATOMS       250000
+#define BATCH           1000
+
+static xcb_connection_t *c;
+static xcb_atom_t atoms[NUM_ATOMS];
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+atom_name(int i, char *name, size_t size)
+{
+    return snprintf(name, size, "_BENCH_ATOM_%d", i);
+}
+
+/* Intern (or, with only_if_exists, look up) every atom */
+static uint64_t
+intern_all(int only_if_exists)
+{
+    xcb_intern_atom_cookie_t cookies[BATCH];
+    uint64_t start = now_usec();
+    char name[32];
+
+    for (int i = 0; i < NUM_ATOMS; i += BATCH) {
+        for (int j = 0; j < BATCH; j++) {
+            int len = atom_name(i + j, name, sizeof(name));
+
+            cookies[j] = xcb_intern_atom(c, only_if_exists, len, name);
+        }
+        for (int j = 0; j < BATCH; j++) {
+            xcb_intern_atom_reply_t *reply =
+                xcb_intern_atom_reply(c, cookies[j], NULL);
+
+            if (!reply || reply->atom == XCB_ATOM_NONE) {
+                fprintf(stderr, "atom %d missing\n", i + j);
+                exit(1);
+            }
+            if (only_if_exists && reply->atom != atoms[i + j]) {
+                fprintf(stderr, "atom %d changed\n", i + j);
+                exit(1);
+            }
+            atoms[i + j] = reply->atom;
+            free(reply);
+        }
+    }
+    return now_usec() - start;
+}
+
+static uint64_t
+name_all(void)
+{
+    xcb_get_atom_name_cookie_t cookies[BATCH];
+    uint64_t start = now_usec();
+    char name[32];
+
+    for (int i = 0; i < NUM_ATOMS; i += BATCH) {
+        for (int j = 0; j < BATCH; j++)
+            cookies[j] = xcb_get_atom_name(c, atoms[i + j]);
+        for (int j = 0; j < BATCH; j++) {
+            xcb_get_atom_name_reply_t *reply =
+                xcb_get_atom_name_reply(c, cookies[j], NULL);
+            int len = atom_name(i + j, name, sizeof(name));
+
+            if (!reply || xcb_get_atom_name_name_length(reply) != len ||
+                memcmp(xcb_get_atom_name_name(reply), name, len) != 0) {
+                fprintf(stderr, "wrong name for atom %d\n", i + j);
+                exit(1);
+            }
+            free(reply);
+        }
+    }
+    return now_usec() - start;
+}
+
+static void
+report(const char *name, uint64_t total)
+{
+    printf("%-24s %8.2f us per request\n", name, (double)total / NUM_ATOMS);
+}
+
+int
+main(int argc, char **argv)
+{
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+
+    printf("%d atoms\n", NUM_ATOMS);
+    report("intern new", intern_all(0));
+    report("intern existing", intern_all(1));
+    report("get atom name", name_all());
+
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A request longer than the BIG-REQUESTS maximum gets BadLength and its
+ * body is skipped, while the client keeps streaming requests behind it.
+ *
+ * The header goes out on its own, so the server's first read of the
+ * body fills a fresh input buffer, as it does for a real client.  The
+ * body is followed by a run of NoOperation requests and a GetInputFocus,
+ * whose reply must come back after the BadLength error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <xcb/xcb.h>
+#include <xcb/bigreq.h>
+
+#define NUM_NOOPS       10000
+#define CHUNK           65536
+
+struct req {
+    uint8_t major;
+    uint8_t pad;
+    uint16_t length;
+};
+
+struct big_req {
+    uint8_t major;
+    uint8_t pad;
+    uint16_t zero;
+    uint32_t length;
+};
+
+static int
+write_all(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+
+    while (size) {
+        ssize_t n = write(fd, p, size);
+
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/* Read one 32 byte event, error or reply header, with a timeout */
+static int
+read_packet(int fd, xcb_generic_error_t *packet)
+{
+    char *p = (char *) packet;
+    size_t got = 0;
+
+    while (got < sizeof(*packet)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        ssize_t n;
+
+        if (poll(&pfd, 1, 10000) <= 0)
+            return -1;
+        n = read(fd, p + got, sizeof(*packet) - got);
+        if (n <= 0)
+            return -1;
+        got += n;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_big_requests_enable_reply_t *bigreq;
+    xcb_generic_error_t packet;
+    struct big_req header = { XCB_NO_OPERATION, 0, 0, 0 };
+    struct req noop = { XCB_NO_OPERATION, 0, 1 };
+    struct req get_focus = { XCB_GET_INPUT_FOCUS, 0, 1 };
+    uint32_t length;
+    char *chunk;
+    size_t body;
+    int fd;
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+
+    bigreq = xcb_big_requests_enable_reply(c, xcb_big_requests_enable(c),
+                                           NULL);
+    if (!bigreq) {
+        fprintf(stderr, "no BIG-REQUESTS extension\n");
+        return 77;
+    }
+    length = bigreq->maximum_request_length + 1;
+    free(bigreq);
+    xcb_flush(c);
+    fd = xcb_get_file_descriptor(c);
+
+    /* From here on the protocol is written by hand; xcb is not used. */
+    header.length = length;
+    if (write_all(fd, &header, sizeof(header)) < 0)
+        return 1;
+    /* let the server read the header before the body arrives */
+    usleep(100000);
+
+    chunk = calloc(1, CHUNK);
+    for (body = (size_t) length * 4 - sizeof(header); body > 0;) {
+        size_t n = body < CHUNK ? body : CHUNK;
+
+        if (write_all(fd, chunk, n) < 0) {
+            fprintf(stderr, "server hung up while skipping the request\n");
+            return 1;
+        }
+        body -= n;
+    }
+    for (int i = 0; i < NUM_NOOPS; i++)
+        if (write_all(fd, &noop, sizeof(noop)) < 0)
+            return 1;
+    if (write_all(fd, &get_focus, sizeof(get_focus)) < 0)
+        return 1;
+    free(chunk);
+
+    if (read_packet(fd, &packet) < 0 || packet.response_type != 0 ||
+        packet.error_code != XCB_LENGTH ||
+        packet.major_code != XCB_NO_OPERATION) {
+        fprintf(stderr, "expected BadLength for the oversized request\n");
+        return 1;
+    }
+    if (read_packet(fd, &packet) < 0 || packet.response_type != 1) {
+        fprintf(stderr, "no reply to the requests after it\n");
+        return 1;
+    }
+
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Threaded Render composites match a single pixman call bit for bit.
+ *
+ * Run against a server started with -renderthreads, so that fbComposite
+ * splits these operations into bands.  Every operator is run with
+ * several combinations of source repeat, transform, filter and mask; the
+ * destination is read back and compared with the same composite done
+ * here in one pixman_image_composite32() call.  The composite area has an
+ * odd size and offset so bands end on uneven rows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pixman.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define DST_W           480
+#define DST_H           360
+#define DST_X           7
+#define DST_Y           5
+#define OP_W            451
+#define OP_H            331
+
+struct config {
+    const char *name;
+    int src_w, src_h;
+    int src_x, src_y;
+    int repeat;
+    const double *transform;    /* first two rows of the source transform */
+    int bilinear;
+    int mask;                   /* 0 none, 1 unified alpha, 2 component alpha */
+    int mask_repeat;
+};
+
+/* rotated by 30 degrees and scaled up by 1.25, then moved */
+static const double rotate[6] = {
+    0.69282032, -0.4, 40.5,
+    0.4, 0.69282032, -25.25,
+};
+
+/* scaled down to three quarters */
+static const double scale[6] = {
+    1.33333333, 0, 0,
+    0, 1.33333333, 0,
+};
+
+static const struct config configs[] = {
+    { "plain", 300, 260, -13, 9, XCB_RENDER_REPEAT_NONE, NULL, 0, 0, 0 },
+    { "repeat normal", 37, 23, 5, 3, XCB_RENDER_REPEAT_NORMAL, NULL, 0, 0, 0 },
+    { "rotate bilinear, repeat pad", 200, 150, -20, -10,
+      XCB_RENDER_REPEAT_PAD, rotate, 1, 0, 0 },
+    { "scale, repeat reflect, mask", 90, 70, 3, 4,
+      XCB_RENDER_REPEAT_REFLECT, scale, 0, 1, XCB_RENDER_REPEAT_NONE },
+    { "component alpha mask", 300, 260, 0, 0, XCB_RENDER_REPEAT_NORMAL,
+      NULL, 0, 2, XCB_RENDER_REPEAT_NORMAL },
+};
+
+/* Render and pixman share operator numbers */
+static const struct { int first, last, minor; } op_ranges[] = {
+    { 0, 13, 0 },               /* Clear .. Saturate */
+    { 16, 27, 2 },              /* Disjoint */
+    { 32, 43, 2 },              /* Conjoint */
+    { 48, 62, 11 },             /* Multiply .. HSLLuminosity */
+};
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_render_pictformat_t argb32;
+static uint32_t seed = 0x2545f491;
+
+static uint32_t
+random_pixel(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static uint32_t *
+random_pixels(int w, int h)
+{
+    uint32_t *bits = malloc(w * h * 4);
+
+    for (int i = 0; i < w * h; i++)
+        bits[i] = random_pixel();
+    return bits;
+}
+
+static xcb_pixmap_t
+upload(uint32_t *bits, int w, int h)
+{
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+
+    xcb_create_pixmap(c, 32, pixmap, screen->root, w, h);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+    /* in strips, to stay under the core request size */
+    for (int y = 0; y < h; y += 64) {
+        int rows = h - y < 64 ? h - y : 64;
+
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc, w, rows,
+                      0, y, 0, 32, w * rows * 4, (uint8_t *) (bits + y * w));
+    }
+    xcb_free_gc(c, gc);
+    return pixmap;
+}
+
+static xcb_render_picture_t
+create_picture(xcb_pixmap_t pixmap, int repeat, int component_alpha)
+{
+    xcb_render_picture_t picture = xcb_generate_id(c);
+    uint32_t values[] = { repeat, component_alpha };
+
+    xcb_render_create_picture(c, picture, pixmap, argb32,
+                              XCB_RENDER_CP_REPEAT |
+                              XCB_RENDER_CP_COMPONENT_ALPHA, values);
+    return picture;
+}
+
+static void
+make_transform(const double *m, struct pixman_transform *t)
+{
+    pixman_transform_init_identity(t);
+    for (int i = 0; i < 6; i++)
+        t->matrix[i / 3][i % 3] = pixman_double_to_fixed(m[i]);
+}
+
+static xcb_render_pictformat_t
+find_argb32(void)
+{
+    xcb_render_query_pict_formats_reply_t *reply =
+        xcb_render_query_pict_formats_reply(c,
+            xcb_render_query_pict_formats(c), NULL);
+    xcb_render_pictforminfo_iterator_t it;
+    xcb_render_pictformat_t format = 0;
+
+    if (!reply)
+        return 0;
+    for (it = xcb_render_query_pict_formats_formats_iterator(reply);
+         it.rem; xcb_render_pictforminfo_next(&it)) {
+        xcb_render_directformat_t *d = &it.data->direct;
+
+        if (it.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            it.data->depth == 32 &&
+            d->alpha_shift == 24 && d->alpha_mask == 0xff &&
+            d->red_shift == 16 && d->red_mask == 0xff &&
+            d->green_shift == 8 && d->green_mask == 0xff &&
+            d->blue_shift == 0 && d->blue_mask == 0xff) {
+            format = it.data->id;
+            break;
+        }
+    }
+    free(reply);
+    return format;
+}
+
+/* Run every operator with one configuration; returns the failure count */
+static int
+run_config(const struct config *cfg, int render_minor,
+           uint32_t *dst_bits, xcb_pixmap_t dst_init)
+{
+    uint32_t *src_bits = random_pixels(cfg->src_w, cfg->src_h);
+    uint32_t *mask_bits = random_pixels(cfg->src_w, cfg->src_h);
+    uint32_t *ref_bits = malloc(DST_W * DST_H * 4);
+    xcb_pixmap_t src_pix, mask_pix = 0, dst_pix;
+    xcb_render_picture_t src, mask = XCB_NONE, dst;
+    pixman_image_t *src_img, *mask_img = NULL, *ref_img;
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    int failures = 0;
+
+    src_pix = upload(src_bits, cfg->src_w, cfg->src_h);
+    src = create_picture(src_pix, cfg->repeat, 0);
+    src_img = pixman_image_create_bits(PIXMAN_a8r8g8b8, cfg->src_w,
+                                       cfg->src_h, src_bits, cfg->src_w * 4);
+    pixman_image_set_repeat(src_img, (pixman_repeat_t) cfg->repeat);
+    pixman_image_set_filter(src_img, cfg->bilinear ? PIXMAN_FILTER_BILINEAR :
+                            PIXMAN_FILTER_NEAREST, NULL, 0);
+
+    if (cfg->transform) {
+        struct pixman_transform t;
+        xcb_render_transform_t xt;
+        const char *filter = cfg->bilinear ? "bilinear" : "nearest";
+
+        make_transform(cfg->transform, &t);
+        pixman_image_set_transform(src_img, &t);
+        xt.matrix11 = t.matrix[0][0];
+        xt.matrix12 = t.matrix[0][1];
+        xt.matrix13 = t.matrix[0][2];
+        xt.matrix21 = t.matrix[1][0];
+        xt.matrix22 = t.matrix[1][1];
+        xt.matrix23 = t.matrix[1][2];
+        xt.matrix31 = t.matrix[2][0];
+        xt.matrix32 = t.matrix[2][1];
+        xt.matrix33 = t.matrix[2][2];
+        xcb_render_set_picture_transform(c, src, xt);
+        xcb_render_set_picture_filter(c, src, strlen(filter), filter, 0, NULL);
+    }
+
+    if (cfg->mask) {
+        mask_pix = upload(mask_bits, cfg->src_w, cfg->src_h);
+        mask = create_picture(mask_pix, cfg->mask_repeat, cfg->mask == 2);
+        mask_img = pixman_image_create_bits(PIXMAN_a8r8g8b8, cfg->src_w,
+                                            cfg->src_h, mask_bits,
+                                            cfg->src_w * 4);
+        pixman_image_set_repeat(mask_img, (pixman_repeat_t) cfg->mask_repeat);
+        pixman_image_set_filter(mask_img, PIXMAN_FILTER_NEAREST, NULL, 0);
+        pixman_image_set_component_alpha(mask_img, cfg->mask == 2);
+    }
+
+    dst_pix = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, dst_pix, screen->root, DST_W, DST_H);
+    xcb_create_gc(c, gc, dst_pix, 0, NULL);
+    dst = create_picture(dst_pix, XCB_RENDER_REPEAT_NONE, 0);
+    ref_img = pixman_image_create_bits(PIXMAN_a8r8g8b8, DST_W, DST_H,
+                                       ref_bits, DST_W * 4);
+
+    for (int r = 0; r < sizeof(op_ranges) / sizeof(op_ranges[0]); r++) {
+        if (render_minor < op_ranges[r].minor)
+            continue;
+        for (int op = op_ranges[r].first; op <= op_ranges[r].last; op++) {
+            xcb_get_image_reply_t *image;
+            uint32_t *got;
+
+            xcb_copy_area(c, dst_init, dst_pix, gc, 0, 0, 0, 0, DST_W, DST_H);
+            xcb_render_composite(c, op, src, mask, dst,
+                                 cfg->src_x, cfg->src_y,
+                                 cfg->src_x, cfg->src_y,
+                                 DST_X, DST_Y, OP_W, OP_H);
+            image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pix,
+                              0, 0, DST_W, DST_H, ~0), NULL);
+
+            memcpy(ref_bits, dst_bits, DST_W * DST_H * 4);
+            pixman_image_composite32((pixman_op_t) op, src_img, mask_img,
+                                     ref_img, cfg->src_x, cfg->src_y,
+                                     cfg->src_x, cfg->src_y,
+                                     DST_X, DST_Y, OP_W, OP_H);
+
+            if (!image ||
+                xcb_get_image_data_length(image) != DST_W * DST_H * 4) {
+                fprintf(stderr, "%s, op %d: GetImage failed\n", cfg->name, op);
+                failures++;
+                free(image);
+                continue;
+            }
+            got = (uint32_t *) xcb_get_image_data(image);
+            for (int i = 0; i < DST_W * DST_H; i++) {
+                if (got[i] != ref_bits[i]) {
+                    fprintf(stderr, "%s, op %d: pixel %d,%d is %08x, "
+                            "expected %08x\n", cfg->name, op,
+                            i % DST_W, i / DST_W, got[i], ref_bits[i]);
+                    failures++;
+                    break;
+                }
+            }
+            free(image);
+        }
+    }
+
+    pixman_image_unref(ref_img);
+    pixman_image_unref(src_img);
+    if (mask_img)
+        pixman_image_unref(mask_img);
+    xcb_render_free_picture(c, dst);
+    xcb_render_free_picture(c, src);
+    if (mask)
+        xcb_render_free_picture(c, mask);
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, dst_pix);
+    xcb_free_pixmap(c, src_pix);
+    if (mask_pix)
+        xcb_free_pixmap(c, mask_pix);
+    free(ref_bits);
+    free(mask_bits);
+    free(src_bits);
+    return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_render_query_version_reply_t *version;
+    uint32_t *dst_bits;
+    xcb_pixmap_t dst_init;
+    int render_minor, failures = 0;
+    uint32_t one = 1;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    /* the references are computed in host byte order */
+    if (xcb_get_setup(c)->image_byte_order !=
+        (*(uint8_t *) &one ? XCB_IMAGE_ORDER_LSB_FIRST :
+         XCB_IMAGE_ORDER_MSB_FIRST)) {
+        fprintf(stderr, "server image byte order differs from ours\n");
+        return 77;
+    }
+
+    version = xcb_render_query_version_reply(c,
+        xcb_render_query_version(c, 0, 11), NULL);
+    if (!version) {
+        fprintf(stderr, "no Render extension\n");
+        return 77;
+    }
+    render_minor = version->minor_version;
+    free(version);
+
+    argb32 = find_argb32();
+    if (!argb32) {
+        fprintf(stderr, "no a8r8g8b8 picture format\n");
+        return 77;
+    }
+
+    dst_bits = random_pixels(DST_W, DST_H);
+    dst_init = upload(dst_bits, DST_W, DST_H);
+
+    for (int i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+        failures += run_config(&configs[i], render_minor, dst_bits, dst_init);
+
+    xcb_free_pixmap(c, dst_init);
+    free(dst_bits);
+    xcb_disconnect(c);
+
+    if (failures)
+        fprintf(stderr, "%d composites differ\n", failures);
+    return failures ? 1 : 0;
+}
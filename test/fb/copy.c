@@ -0,0 +1,222 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * CopyArea within and between pixmaps matches a plain memory copy.
+ *
+ * Run against a server started with -renderthreads, so that fbCopyNtoN
+ * splits large copies into bands.  Boxes are moved by small steps in
+ * each direction inside one pixmap, where the source and destination
+ * overlap and the copy must not be split, and across pixmaps, where it
+ * is.  Every result is read back and compared with the same copy done
+ * here through a temporary buffer, at depths 8, 16 and 32.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+
+#define PIX_W           640
+#define PIX_H           480
+
+struct copy {
+    const char *name;
+    int src_x, src_y;
+    int dst_x, dst_y;
+    int w, h;
+    int same;                   /* copy within one pixmap */
+};
+
+static const struct copy copies[] = {
+    { "left by 1", 21, 16, 20, 16, 600, 440, 1 },
+    { "right by 1", 20, 16, 21, 16, 600, 440, 1 },
+    { "left by 3", 23, 9, 20, 9, 451, 331, 1 },
+    { "right by 3", 20, 9, 23, 9, 451, 331, 1 },
+    { "up by 1", 16, 21, 16, 20, 600, 440, 1 },
+    { "down by 1", 16, 20, 16, 21, 600, 440, 1 },
+    { "up by 17", 7, 30, 7, 13, 451, 331, 1 },
+    { "down by 17", 7, 13, 7, 30, 451, 331, 1 },
+    { "up and left", 25, 27, 20, 20, 600, 440, 1 },
+    { "down and right", 20, 20, 25, 27, 600, 440, 1 },
+    { "up and right", 20, 27, 25, 20, 600, 440, 1 },
+    { "down and left", 25, 20, 20, 27, 600, 440, 1 },
+    { "whole pixmap", 0, 0, 0, 0, PIX_W, PIX_H, 0 },
+    { "between pixmaps", 13, 5, 40, 71, 451, 331, 0 },
+};
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static uint32_t seed = 0x2545f491;
+
+static uint8_t *
+random_bytes(int size)
+{
+    uint8_t *bytes = malloc(size);
+
+    for (int i = 0; i < size; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        bytes[i] = seed;
+    }
+    return bytes;
+}
+
+static xcb_pixmap_t
+upload(uint8_t *bytes, int depth, int stride)
+{
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+
+    xcb_create_pixmap(c, depth, pixmap, screen->root, PIX_W, PIX_H);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+    /* in strips, to stay under the core request size */
+    for (int y = 0; y < PIX_H; y += 64) {
+        int rows = PIX_H - y < 64 ? PIX_H - y : 64;
+
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc, PIX_W, rows,
+                      0, y, 0, depth, rows * stride, bytes + y * stride);
+    }
+    xcb_free_gc(c, gc);
+    return pixmap;
+}
+
+/* Bits per pixel for depth, or 0 if the server has no such format */
+static int
+depth_bpp(int depth)
+{
+    xcb_format_iterator_t it;
+
+    for (it = xcb_setup_pixmap_formats_iterator(xcb_get_setup(c));
+         it.rem; xcb_format_next(&it)) {
+        if (it.data->depth == depth)
+            return it.data->bits_per_pixel;
+    }
+    return 0;
+}
+
+/* Run every copy at one depth; returns the failure count */
+static int
+run_depth(int depth, int bpp)
+{
+    int cpp = bpp / 8;
+    int stride = PIX_W * cpp;   /* a multiple of any scanline pad */
+    int size = stride * PIX_H;
+    uint8_t *init_bits = random_bytes(size);
+    uint8_t *src_bits = random_bytes(size);
+    uint8_t *ref_bits = malloc(size);
+    uint8_t *tmp = malloc(size);
+    xcb_pixmap_t init_pix, src_pix, dst_pix;
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    int failures = 0;
+
+    init_pix = upload(init_bits, depth, stride);
+    src_pix = upload(src_bits, depth, stride);
+    dst_pix = xcb_generate_id(c);
+    xcb_create_pixmap(c, depth, dst_pix, screen->root, PIX_W, PIX_H);
+    xcb_create_gc(c, gc, dst_pix, 0, NULL);
+
+    for (int i = 0; i < sizeof(copies) / sizeof(copies[0]); i++) {
+        const struct copy *cp = &copies[i];
+        const uint8_t *from = cp->same ? init_bits : src_bits;
+        xcb_get_image_reply_t *image;
+        const uint8_t *got;
+
+        xcb_copy_area(c, init_pix, dst_pix, gc, 0, 0, 0, 0, PIX_W, PIX_H);
+        xcb_copy_area(c, cp->same ? dst_pix : src_pix, dst_pix, gc,
+                      cp->src_x, cp->src_y, cp->dst_x, cp->dst_y,
+                      cp->w, cp->h);
+        image = xcb_get_image_reply(c,
+            xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pix,
+                          0, 0, PIX_W, PIX_H, ~0), NULL);
+
+        memcpy(ref_bits, init_bits, size);
+        for (int y = 0; y < cp->h; y++)
+            memcpy(tmp + y * cp->w * cpp,
+                   from + (cp->src_y + y) * stride + cp->src_x * cpp,
+                   cp->w * cpp);
+        for (int y = 0; y < cp->h; y++)
+            memcpy(ref_bits + (cp->dst_y + y) * stride + cp->dst_x * cpp,
+                   tmp + y * cp->w * cpp, cp->w * cpp);
+
+        if (!image || xcb_get_image_data_length(image) != size) {
+            fprintf(stderr, "depth %d, %s: GetImage failed\n",
+                    depth, cp->name);
+            failures++;
+            free(image);
+            continue;
+        }
+        got = xcb_get_image_data(image);
+        for (int j = 0; j < size; j++) {
+            if (got[j] != ref_bits[j]) {
+                fprintf(stderr, "depth %d, %s: pixel %d,%d differs\n",
+                        depth, cp->name, j % stride / cpp, j / stride);
+                failures++;
+                break;
+            }
+        }
+        free(image);
+    }
+
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, dst_pix);
+    xcb_free_pixmap(c, src_pix);
+    xcb_free_pixmap(c, init_pix);
+    free(tmp);
+    free(ref_bits);
+    free(src_bits);
+    free(init_bits);
+    return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int depths[] = { 8, 16, 32 };
+    int failures = 0, tested = 0;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    for (int i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        int bpp = depth_bpp(depths[i]);
+
+        if (bpp != 8 && bpp != 16 && bpp != 32)
+            continue;
+        failures += run_depth(depths[i], bpp);
+        tested++;
+    }
+
+    xcb_disconnect(c);
+
+    if (!tested) {
+        fprintf(stderr, "no pixmap format to test\n");
+        return 77;
+    }
+    if (failures)
+        fprintf(stderr, "%d copies differ\n", failures);
+    return failures ? 1 : 0;
+}
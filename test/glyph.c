@@ -0,0 +1,112 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the glyph set memory accounting in render/glyph.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include "misc.h"
+#include "dix.h"
+#include "dixstruct.h"
+#include "resource.h"
+#include "picturestr.h"
+#include "glyphstr.h"
+
+#include "tests-common.h"
+
+static GlyphPtr
+glyph_new(int id)
+{
+    xGlyphInfo gi = { .width = 8, .height = 16 };
+    GlyphPtr glyph = AllocateGlyph(&gi, GlyphFormat8);
+
+    assert(glyph);
+    memset(glyph->sha1, id, sizeof(glyph->sha1));
+    return glyph;
+}
+
+static unsigned long
+glyphset_base(GlyphSetPtr glyphSet)
+{
+    return sizeof(GlyphSetRec) +
+        glyphSet->hash.hashSet->size * sizeof(GlyphRefRec);
+}
+
+static void
+glyphset_bytes_test(void)
+{
+    GlyphSetPtr a = AllocateGlyphSet(GlyphFormat8, NULL);
+    GlyphSetPtr b = AllocateGlyphSet(GlyphFormat8, NULL);
+    GlyphPtr shared = glyph_new(1), own = glyph_new(2), dup = glyph_new(1);
+    ResourceSizeRec size;
+    unsigned long glyphSize = shared->size;
+
+    assert(a && b);
+
+    /* an empty set is charged for its table only */
+    GetGlyphSetBytes(a, 0, &size);
+    assert(size.resourceSize == glyphset_base(a));
+    assert(size.pixmapRefSize == 0);
+    assert(size.refCnt == 1);
+
+    AddGlyph(a, shared, 1);
+    AddGlyph(a, own, 2);
+    AddGlyph(b, shared, 1);
+    assert(shared->refcnt == 2);
+
+    /* a shared glyph is split between the sets holding it */
+    GetGlyphSetBytes(a, 0, &size);
+    assert(size.resourceSize == glyphset_base(a) + glyphSize / 2 + glyphSize);
+    GetGlyphSetBytes(b, 0, &size);
+    assert(size.resourceSize == glyphset_base(b) + glyphSize / 2);
+
+    /* the same image uploaded again is folded into the existing glyph */
+    AddGlyph(b, dup, 3);
+    assert(FindGlyph(b, 3) == shared);
+    assert(shared->refcnt == 3);
+    GetGlyphSetBytes(a, 0, &size);
+    assert(size.resourceSize == glyphset_base(a) + glyphSize / 3 + glyphSize);
+    GetGlyphSetBytes(b, 0, &size);
+    assert(size.resourceSize == glyphset_base(b) + 2 * (glyphSize / 3));
+
+    FreeGlyphSet(a, 0);
+    FreeGlyphSet(b, 0);
+}
+
+int
+glyph_test(void)
+{
+    ClientRec server;
+
+    memset(&server, 0, sizeof(server));
+    serverClient = &server;
+    assert(InitClientResources(serverClient));
+
+    glyphset_bytes_test();
+
+    return 0;
+}
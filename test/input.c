@@ -26,6 +26,7 @@
 #endif
 
 #include <stdint.h>
+#include <stdio.h>
 #include <X11/X.h>
 #include "misc.h"
 #include "resource.h"
@@ -1841,6 +1842,297 @@ mieq_test(void)
     mieqFini();
 }
 
+/* Events are copied out of the queue a batch at a time and processed with
+ * the input lock released, so the input thread may enqueue more events, and
+ * grow the queue, while a batch is still being delivered.  None of them may
+ * be lost or delivered out of order.
+ */
+#define MIEQ_BATCH_EVENTS 3000
+
+static uint32_t mieq_batch_delivered[MIEQ_BATCH_EVENTS + 1];
+static uint32_t mieq_batch_count;
+static uint32_t mieq_batch_refill_at, mieq_batch_refill;
+static uint32_t mieq_batch_next;
+
+static void
+mieq_batch_handler(int screenNum, InternalEvent *ie, DeviceIntPtr dev)
+{
+    RawDeviceEvent *e = (RawDeviceEvent *) ie;
+
+    assert(mieq_batch_count < MIEQ_BATCH_EVENTS);
+    mieq_batch_delivered[mieq_batch_count++] = e->flags;
+
+    /* play the input thread, in the middle of a batch */
+    if (e->flags == mieq_batch_refill_at) {
+        input_lock();
+        _mieq_test_generate_events(mieq_batch_next, mieq_batch_refill);
+        input_unlock();
+        mieq_batch_next += mieq_batch_refill;
+    }
+}
+
+static void
+mieq_batch_run(uint32_t count, uint32_t refill_at, uint32_t refill)
+{
+    uint32_t first = mieq_batch_next, i;
+
+    mieq_batch_count = 0;
+    mieq_batch_refill_at = first + refill_at;
+    mieq_batch_refill = refill;
+
+    _mieq_test_generate_events(first, count);
+    mieq_batch_next += count;
+    mieqProcessInputEvents();
+
+    /* everything queued before and during the drain came out, in order */
+    assert(mieq_batch_count == count + refill);
+    for (i = 0; i < mieq_batch_count; i++)
+        assert(mieq_batch_delivered[i] == first + i);
+
+    /* and nothing is left behind */
+    mieq_batch_count = 0;
+    mieqProcessInputEvents();
+    assert(mieq_batch_count == 0);
+}
+
+static void
+mieq_batch_test(void)
+{
+    mieq_batch_next = 1;
+    mieqInit();
+    mieqSetHandler(ET_RawMotion, mieq_batch_handler);
+
+    /* a drain that doesn't grow the queue, but leaves its head near the
+     * end so the next events wrap around */
+    mieq_batch_run(400, 0, 0);
+
+    /* grow from 512 to 1024 with the queue wrapped, while a batch is out */
+    mieq_batch_run(300, 50, 700);
+
+    /* grow twice more, to 4096, refilling in the last batch */
+    mieq_batch_run(1000, 995, 2000);
+
+    mieqSetHandler(ET_RawMotion, NULL);
+    mieqFini();
+}
+
+/* With -compressmotion, a motion event is dropped when the next event of
+ * its device in the same batch, past any raw motion, is a motion event
+ * that supersedes it.  Raw events are always delivered.
+ */
+#define MIEQ_COMPRESS_RAW(tag)    { ET_RawMotion, tag }
+#define MIEQ_COMPRESS_MOTION(x)   { ET_Motion, x }
+
+typedef struct {
+    int type;
+    int tag;                    /* raw: flags, motion: root_x */
+} mieq_compress_event;
+
+static mieq_compress_event mieq_compress_seen[16];
+static int mieq_compress_nseen;
+static WindowRec mieq_compress_root, mieq_compress_left, mieq_compress_right;
+
+static void
+mieq_compress_proc(InternalEvent *ev, DeviceIntPtr dev)
+{
+    mieq_compress_event *seen = &mieq_compress_seen[mieq_compress_nseen++];
+
+    assert(mieq_compress_nseen <= ARRAY_SIZE(mieq_compress_seen));
+    seen->type = ev->any.type;
+    if (ev->any.type == ET_RawMotion)
+        seen->tag = ev->raw_event.flags;
+    else
+        seen->tag = ev->device_event.root_x;
+}
+
+/* two top-level windows side by side */
+static WindowPtr
+mieq_compress_xy_to_window(ScreenPtr pScreen, SpritePtr pSprite, int x, int y)
+{
+    return x < 100 ? &mieq_compress_left : &mieq_compress_right;
+}
+
+static void
+mieq_compress_raw(DeviceIntPtr dev, int tag)
+{
+    RawDeviceEvent e = { 0 };
+
+    e.header = ET_Internal;
+    e.type = ET_RawMotion;
+    e.length = sizeof(e);
+    e.time = GetTimeInMillis();
+    e.deviceid = dev->id;
+    e.sourceid = dev->id;
+    e.flags = tag;
+    SetBit(e.valuators.mask, 0);
+
+    mieqEnqueue(dev, (InternalEvent *) &e);
+}
+
+static void
+mieq_compress_motion(DeviceIntPtr dev, int x, int buttons, int nvaluators)
+{
+    DeviceEvent e = { 0 };
+    int i;
+
+    e.header = ET_Internal;
+    e.type = ET_Motion;
+    e.length = sizeof(e);
+    e.time = GetTimeInMillis();
+    e.deviceid = dev->id;
+    e.sourceid = dev->id;
+    e.root = mieq_compress_root.drawable.id;
+    e.root_x = x;
+    e.root_y = 10;
+    for (i = 0; i < nvaluators; i++)
+        SetBit(e.valuators.mask, i);
+    if (buttons)
+        SetBit(e.buttons, 1);
+
+    mieqEnqueue(dev, (InternalEvent *) &e);
+}
+
+static void
+mieq_compress_expect(const mieq_compress_event *expected, int n)
+{
+    int i;
+
+    mieq_compress_nseen = 0;
+    mieqProcessInputEvents();
+
+    assert(mieq_compress_nseen == n);
+    for (i = 0; i < n; i++) {
+        assert(mieq_compress_seen[i].type == expected[i].type);
+        assert(mieq_compress_seen[i].tag == expected[i].tag);
+    }
+}
+
+static void
+mieq_compress_test(void)
+{
+    static DeviceIntRec dev_a, dev_b;
+    static SpriteInfoRec spriteInfo;
+    static SpriteRec sprite;
+    static ScreenRec screen;
+    static WindowPtr trace[4];
+    DeviceIntPtr devs[] = { &dev_a, &dev_b };
+    int i;
+
+    memset(&screen, 0, sizeof(screen));
+    screen.XYToWindow = mieq_compress_xy_to_window;
+    mieq_compress_root.drawable.id = 0x100;
+    mieq_compress_root.drawable.pScreen = &screen;
+
+    memset(&sprite, 0, sizeof(sprite));
+    trace[0] = &mieq_compress_root;
+    sprite.spriteTrace = trace;
+    sprite.spriteTraceSize = ARRAY_SIZE(trace);
+    sprite.spriteTraceGood = 1;
+    sprite.physLimits.x2 = 200;
+    sprite.physLimits.y2 = 200;
+    spriteInfo.sprite = &sprite;
+
+    for (i = 0; i < ARRAY_SIZE(devs); i++) {
+        memset(devs[i], 0, sizeof(*devs[i]));
+        devs[i]->id = 2 + i;
+        devs[i]->type = SLAVE;
+        devs[i]->enabled = TRUE;
+        devs[i]->spriteInfo = &spriteInfo;
+        devs[i]->public.processInputProc = mieq_compress_proc;
+    }
+
+    mieqInit();
+    mieqCompressMotion = TRUE;
+
+    /* the first motion is superseded, both raw events make it */
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_RAW(1), MIEQ_COMPRESS_RAW(2),
+            MIEQ_COMPRESS_MOTION(11),
+        };
+
+        mieq_compress_raw(&dev_a, 1);
+        mieq_compress_motion(&dev_a, 10, 0, 2);
+        mieq_compress_raw(&dev_a, 2);
+        mieq_compress_motion(&dev_a, 11, 0, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    /* a button went down in between */
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_MOTION(12), MIEQ_COMPRESS_RAW(3),
+            MIEQ_COMPRESS_MOTION(13),
+        };
+
+        mieq_compress_motion(&dev_a, 12, 0, 2);
+        mieq_compress_raw(&dev_a, 3);
+        mieq_compress_motion(&dev_a, 13, 1, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    /* the later motion lacks a valuator of the earlier one, but not the
+     * other way around */
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_MOTION(14), MIEQ_COMPRESS_RAW(4),
+            MIEQ_COMPRESS_RAW(5), MIEQ_COMPRESS_MOTION(16),
+        };
+
+        mieq_compress_motion(&dev_a, 14, 0, 2);
+        mieq_compress_raw(&dev_a, 4);
+        mieq_compress_motion(&dev_a, 15, 0, 1);
+        mieq_compress_raw(&dev_a, 5);
+        mieq_compress_motion(&dev_a, 16, 0, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    /* another device's events in between, or the later motion from it */
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_MOTION(17), MIEQ_COMPRESS_RAW(6),
+            MIEQ_COMPRESS_MOTION(18), MIEQ_COMPRESS_RAW(7),
+            MIEQ_COMPRESS_MOTION(19),
+        };
+
+        mieq_compress_motion(&dev_a, 17, 0, 2);
+        mieq_compress_raw(&dev_b, 6);
+        mieq_compress_motion(&dev_a, 18, 0, 2);
+        mieq_compress_raw(&dev_a, 7);
+        mieq_compress_motion(&dev_b, 19, 0, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    /* the pointer moved into another window */
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_MOTION(20), MIEQ_COMPRESS_RAW(8),
+            MIEQ_COMPRESS_MOTION(150),
+        };
+
+        mieq_compress_motion(&dev_a, 20, 0, 2);
+        mieq_compress_raw(&dev_a, 8);
+        mieq_compress_motion(&dev_a, 150, 0, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    /* and nothing is dropped without -compressmotion */
+    mieqCompressMotion = FALSE;
+    {
+        const mieq_compress_event expected[] = {
+            MIEQ_COMPRESS_MOTION(21), MIEQ_COMPRESS_RAW(9),
+            MIEQ_COMPRESS_MOTION(22),
+        };
+
+        mieq_compress_motion(&dev_a, 21, 0, 2);
+        mieq_compress_raw(&dev_a, 9);
+        mieq_compress_motion(&dev_a, 22, 0, 2);
+        mieq_compress_expect(expected, ARRAY_SIZE(expected));
+    }
+
+    mieqFini();
+}
+
 /* Simple check that we're replaying events in-order */
 static void
 process_input_proc(InternalEvent *ev, DeviceIntPtr device)
@@ -1927,6 +2219,8 @@ input_test(void)
     dix_get_master();
     input_option_test();
     mieq_test();
+    mieq_batch_test();
+    mieq_compress_test();
 
     return 0;
 }
@@ -0,0 +1,131 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Input event latency through the event queue.
+ *
+ * Moves the pointer with XTest, which queues the motion like a driver
+ * would, and waits for the MotionNotify on the root window.  Single
+ * events measure the round trip; bursts of events show how long the
+ * last of a burst waits behind the others.  Prints the average and the
+ * worst time per pass.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xtest.h>
+
+#define NUM_EVENTS      20000
+
+static xcb_connection_t *c;
+static xcb_window_t root;
+static int x;
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Wait for the motion to (x, 10), skipping any older ones */
+static void
+wait_for_motion(void)
+{
+    for (;;) {
+        xcb_generic_event_t *ev = xcb_wait_for_event(c);
+        int done;
+
+        if (!ev) {
+            fprintf(stderr, "connection lost\n");
+            exit(1);
+        }
+        if (ev->response_type == 0) {
+            fprintf(stderr, "X error %d\n",
+                    ((xcb_generic_error_t *)ev)->error_code);
+            exit(1);
+        }
+        done = (ev->response_type & 0x7f) == XCB_MOTION_NOTIFY &&
+            ((xcb_motion_notify_event_t *)ev)->root_x == x;
+        free(ev);
+        if (done)
+            return;
+    }
+}
+
+/* Move the pointer burst times per sample and wait for the last motion */
+static void
+run(const char *name, int burst)
+{
+    uint64_t total = 0, worst = 0;
+
+    for (int i = 0; i < NUM_EVENTS; i += burst) {
+        uint64_t start = now_usec(), t;
+
+        for (int j = 0; j < burst; j++) {
+            x = x % 100 + 1;
+            xcb_test_fake_input(c, XCB_MOTION_NOTIFY, 0, XCB_CURRENT_TIME,
+                                root, x, 10, 0);
+        }
+        xcb_flush(c);
+        wait_for_motion();
+
+        t = now_usec() - start;
+        total += t;
+        if (t > worst)
+            worst = t;
+    }
+    printf("%-24s %8.2f us average, %8.2f us worst\n", name,
+           (double)total / (NUM_EVENTS / burst), (double)worst);
+}
+
+int
+main(int argc, char **argv)
+{
+    const xcb_query_extension_reply_t *ext;
+    uint32_t mask = XCB_EVENT_MASK_POINTER_MOTION;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    ext = xcb_get_extension_data(c, &xcb_test_id);
+    if (!ext || !ext->present) {
+        printf("No XTEST present\n");
+        return 77;
+    }
+
+    root = xcb_setup_roots_iterator(xcb_get_setup(c)).data->root;
+    xcb_change_window_attributes(c, root, XCB_CW_EVENT_MASK, &mask);
+
+    printf("%d motion events\n", NUM_EVENTS);
+    run("single motion", 1);
+    run("bursts of 8", 8);
+    run("bursts of 64", 64);
+
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * PresentPixmap load on the fake vblank timeline.
+ *
+ * Xvfb has no vblank hardware, so every presentation goes through
+ * present_fake.c. Creates a few hundred small windows, gives each a
+ * backlog of presentations far in the future, then has every window
+ * present once per frame while a pacing window measures how late the
+ * server delivers the frame. Finally destroys the windows, aborting the
+ * backlog. Prints the time to queue and abort the backlog and the
+ * average and worst frame delivery delay.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/present.h>
+
+#define NUM_WINDOWS     384
+#define WINDOW_SIZE     16
+#define BACKLOG         8
+#define FRAMES          120
+#define FAKE_INTERVAL   16667   /* present_fake.c runs at 60Hz */
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_special_event_t *special;
+static xcb_window_t windows[NUM_WINDOWS];
+static xcb_pixmap_t pixmaps[NUM_WINDOWS];
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+round_trip(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_window_t
+create_window(int x, int y, int w, int h)
+{
+    xcb_window_t win = xcb_generate_id(c);
+    uint32_t values[] = { screen->black_pixel };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, screen->root, x, y, w, h,
+                      0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL, values);
+    xcb_map_window(c, win);
+    return win;
+}
+
+static void
+present(int i, uint32_t serial, uint64_t target_msc)
+{
+    xcb_present_pixmap(c, windows[i], pixmaps[i], serial, XCB_NONE, XCB_NONE,
+                       0, 0, XCB_NONE, XCB_NONE, XCB_NONE,
+                       XCB_PRESENT_OPTION_NONE, target_msc, 0, 0, 0, NULL);
+}
+
+/* Wait for the pacing window's MSC notify with 'serial' */
+static void
+wait_msc(uint32_t serial, uint64_t *ust, uint64_t *msc)
+{
+    for (;;) {
+        xcb_generic_event_t *ev = xcb_wait_for_special_event(c, special);
+        xcb_present_complete_notify_event_t *ce = (void *) ev;
+
+        if (!ev) {
+            fprintf(stderr, "lost connection to the X server\n");
+            exit(1);
+        }
+        if (ce->event_type == XCB_PRESENT_COMPLETE_NOTIFY &&
+            ce->serial == serial) {
+            *ust = ce->ust;
+            *msc = ce->msc;
+            free(ev);
+            return;
+        }
+        free(ev);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int cols, i, frame;
+    xcb_window_t pace;
+    xcb_present_event_t eid;
+    uint64_t ust, msc, start, queue_time, abort_time;
+    uint64_t total = 0, worst = 0;
+    xcb_present_query_version_reply_t *version;
+    uint32_t serial = 0;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    version = xcb_present_query_version_reply(c,
+        xcb_present_query_version(c, XCB_PRESENT_MAJOR_VERSION,
+                                  XCB_PRESENT_MINOR_VERSION), NULL);
+    if (!version) {
+        fprintf(stderr, "no Present extension\n");
+        return 77;
+    }
+    free(version);
+
+    cols = screen->width_in_pixels / WINDOW_SIZE;
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        windows[i] = create_window((i % cols) * WINDOW_SIZE,
+                                   (i / cols + 1) * WINDOW_SIZE,
+                                   WINDOW_SIZE, WINDOW_SIZE);
+        pixmaps[i] = xcb_generate_id(c);
+        xcb_create_pixmap(c, screen->root_depth, pixmaps[i], windows[i],
+                          WINDOW_SIZE, WINDOW_SIZE);
+    }
+
+    pace = create_window(0, 0, WINDOW_SIZE, WINDOW_SIZE);
+    eid = xcb_generate_id(c);
+    special = xcb_register_for_special_xge(c, &xcb_present_id, eid, NULL);
+    xcb_present_select_input(c, eid, pace,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+
+    xcb_present_notify_msc(c, pace, ++serial, 0, 0, 0);
+    xcb_flush(c);
+    wait_msc(serial, &ust, &msc);
+
+    /* A backlog well past the end of the run, so it is only ever aborted */
+    start = now_usec();
+    for (i = 0; i < NUM_WINDOWS; i++)
+        for (int b = 0; b < BACKLOG; b++)
+            present(i, ++serial, msc + FRAMES * 4 + b * NUM_WINDOWS + i);
+    round_trip();
+    queue_time = now_usec() - start;
+
+    for (frame = 0; frame < FRAMES; frame++) {
+        uint64_t target = msc + 1, late;
+
+        for (i = 0; i < NUM_WINDOWS; i++)
+            present(i, ++serial, target);
+        /* Queued after the windows, so it completes after them */
+        xcb_present_notify_msc(c, pace, ++serial, target, 0, 0);
+        xcb_flush(c);
+        wait_msc(serial, &ust, &msc);
+
+        late = ust > target * FAKE_INTERVAL ? ust - target * FAKE_INTERVAL : 0;
+        total += late;
+        if (late > worst)
+            worst = late;
+    }
+
+    start = now_usec();
+    for (i = 0; i < NUM_WINDOWS; i++)
+        xcb_destroy_window(c, windows[i]);
+    round_trip();
+    abort_time = now_usec() - start;
+
+    printf("%d windows, %d queued per window\n", NUM_WINDOWS, BACKLOG);
+    printf("%-24s %8llu us\n", "queue backlog",
+           (unsigned long long)queue_time);
+    printf("%-24s %8.1f us avg %8llu us max\n", "frame delivery",
+           (double)total / FRAMES, (unsigned long long)worst);
+    printf("%-24s %8llu us\n", "abort backlog",
+           (unsigned long long)abort_time);
+
+    for (i = 0; i < NUM_WINDOWS; i++)
+        xcb_free_pixmap(c, pixmaps[i]);
+    xcb_unregister_for_special_event(c, special);
+    xcb_destroy_window(c, pace);
+    round_trip();
+    xcb_disconnect(c);
+    return 0;
+}
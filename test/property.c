@@ -0,0 +1,159 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for window property lookup in dix/property.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+#include "dixstruct.h"
+#include "windowstr.h"
+#include "propertyst.h"
+
+#include "tests-common.h"
+
+#define PROPERTY_BASE_ATOM 1000
+
+static void
+init_property_window(WindowPtr pWin)
+{
+    memset(pWin, 0, sizeof(*pWin));
+    pWin->optional = calloc(1, sizeof(WindowOptRec));
+    assert(pWin->optional);
+}
+
+static void
+add_properties(ClientPtr client, WindowPtr pWin, int nprops)
+{
+    CARD32 value;
+    int i, rc;
+
+    for (i = 0; i < nprops; i++) {
+        value = i;
+        rc = dixChangeWindowProperty(client, pWin, PROPERTY_BASE_ATOM + i,
+                                     XA_CARDINAL, 32, PropModeReplace, 1,
+                                     &value, FALSE);
+        assert(rc == Success);
+    }
+}
+
+static void
+property_lookup(void)
+{
+    ClientRec client = { 0 };
+    WindowRec window;
+    PropertyPtr pProp;
+    CARD32 value = 42;
+    int i, rc, n;
+
+    init_property_window(&window);
+    add_properties(&client, &window, 100);
+
+    /* every property is found, and holds the value it was created with */
+    for (i = 0; i < 100; i++) {
+        rc = dixLookupProperty(&pProp, &window, PROPERTY_BASE_ATOM + i,
+                               &client, DixReadAccess);
+        assert(rc == Success);
+        assert(pProp->propertyName == PROPERTY_BASE_ATOM + i);
+        assert(*(CARD32 *) pProp->data == i);
+    }
+    rc = dixLookupProperty(&pProp, &window, PROPERTY_BASE_ATOM + 100,
+                           &client, DixReadAccess);
+    assert(rc == BadMatch);
+    assert(pProp == NULL);
+
+    /* replacing a property keeps it in place in the list */
+    rc = dixChangeWindowProperty(&client, &window, PROPERTY_BASE_ATOM + 50,
+                                 XA_CARDINAL, 32, PropModeReplace, 1,
+                                 &value, FALSE);
+    assert(rc == Success);
+    rc = dixLookupProperty(&pProp, &window, PROPERTY_BASE_ATOM + 50,
+                           &client, DixReadAccess);
+    assert(rc == Success);
+    assert(*(CARD32 *) pProp->data == 42);
+
+    /* ListProperties order: newest first, no duplicates */
+    n = 0;
+    for (pProp = window.optional->userProps; pProp; pProp = pProp->next) {
+        assert(pProp->propertyName == PROPERTY_BASE_ATOM + 99 - n);
+        n++;
+    }
+    assert(n == 100);
+
+    DeleteAllWindowProperties(&window);
+    assert(window.optional->userProps == NULL);
+    assert(window.optional->userPropIndex == NULL);
+    rc = dixLookupProperty(&pProp, &window, PROPERTY_BASE_ATOM,
+                           &client, DixReadAccess);
+    assert(rc == BadMatch);
+    free(window.optional);
+}
+
+/* windows with a few properties search the list, larger ones switch to
+ * the index and find the same properties there */
+static void
+property_index(int nprops)
+{
+    ClientRec client = { 0 };
+    WindowRec window;
+    PropertyPtr pProp;
+    int i, rc;
+
+    init_property_window(&window);
+    add_properties(&client, &window, nprops);
+    assert(!window.optional->userPropIndex == (nprops < 16));
+
+    for (i = 0; i < nprops; i++) {
+        rc = dixLookupProperty(&pProp, &window,
+                               PROPERTY_BASE_ATOM + (i * 7) % nprops,
+                               &client, DixReadAccess);
+        assert(rc == Success);
+        assert(pProp->propertyName == PROPERTY_BASE_ATOM + (i * 7) % nprops);
+        assert(*(CARD32 *) pProp->data == (i * 7) % nprops);
+    }
+    rc = dixLookupProperty(&pProp, &window, PROPERTY_BASE_ATOM + nprops,
+                           &client, DixReadAccess);
+    assert(rc == BadMatch);
+
+    DeleteAllWindowProperties(&window);
+    assert(window.optional->userPropIndex == NULL);
+    free(window.optional);
+}
+
+int
+property_test(void)
+{
+    property_lookup();
+
+    property_index(10);
+    property_index(100);
+    property_index(1000);
+
+    return 0;
+}
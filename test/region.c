@@ -0,0 +1,244 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Randomized tests of RegionFromRects/RegionValidate and RegionAppend in
+ * dix/region.c against a brute-force rasterization of the input.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "gc.h"
+#include "regionstr.h"
+
+#include "tests-common.h"
+
+#define GRID 256
+#define NUM_ROUNDS 2000
+
+static unsigned char coverage[GRID][GRID];
+
+/* Check that reg is a proper y-x banded, fully coalesced region */
+static void
+region_check_canonical(RegionPtr reg)
+{
+    BoxPtr rects = RegionRects(reg);
+    int n = RegionNumRects(reg);
+    int i, band, prevBand = -1;
+    BoxRec ext;
+
+    if (n == 0) {
+        assert(reg->extents.x1 == reg->extents.x2);
+        assert(reg->extents.y1 == reg->extents.y2);
+        return;
+    }
+    if (n == 1) {
+        assert(!reg->data || reg->data->numRects == 1);
+        assert(memcmp(&reg->extents, rects, sizeof(BoxRec)) == 0);
+        return;
+    }
+
+    ext = rects[0];
+    for (band = 0; band < n; ) {
+        int end = band;
+
+        while (end < n && rects[end].y1 == rects[band].y1) {
+            assert(rects[end].x1 < rects[end].x2);
+            assert(rects[end].y1 < rects[end].y2);
+            assert(rects[end].y2 == rects[band].y2);
+            /* boxes within a band are sorted and don't touch */
+            if (end > band)
+                assert(rects[end].x1 > rects[end - 1].x2);
+            if (rects[end].x1 < ext.x1)
+                ext.x1 = rects[end].x1;
+            if (rects[end].x2 > ext.x2)
+                ext.x2 = rects[end].x2;
+            end++;
+        }
+        if (prevBand >= 0) {
+            assert(rects[band].y1 >= rects[prevBand].y2);
+            /* touching bands with the same spans should have coalesced */
+            if (rects[band].y1 == rects[prevBand].y2 &&
+                end - band == band - prevBand) {
+                for (i = 0; i < end - band; i++)
+                    if (rects[band + i].x1 != rects[prevBand + i].x1 ||
+                        rects[band + i].x2 != rects[prevBand + i].x2)
+                        break;
+                assert(i < end - band);
+            }
+        }
+        prevBand = band;
+        band = end;
+    }
+    ext.y2 = rects[n - 1].y2;
+    assert(memcmp(&ext, &reg->extents, sizeof(BoxRec)) == 0);
+}
+
+static void
+region_check_coverage(RegionPtr reg)
+{
+    static unsigned char got[GRID][GRID];
+    BoxPtr rects = RegionRects(reg);
+    int n = RegionNumRects(reg);
+    int i, x, y;
+
+    memset(got, 0, sizeof(got));
+    for (i = 0; i < n; i++)
+        for (y = rects[i].y1; y < rects[i].y2; y++)
+            for (x = rects[i].x1; x < rects[i].x2; x++) {
+                assert(!got[y][x]);
+                got[y][x] = 1;
+            }
+    assert(memcmp(got, coverage, sizeof(got)) == 0);
+}
+
+static void
+random_rects(xRectangle *rects, int n, int maxsize, Bool aligned)
+{
+    int i, x, y;
+
+    memset(coverage, 0, sizeof(coverage));
+    for (i = 0; i < n; i++) {
+        if (aligned) {
+            /* a grid of cells, which gives coalescing something to do */
+            rects[i].x = (rand() % 8) * 32;
+            rects[i].y = (rand() % 8) * 32;
+            rects[i].width = 32 * (1 + rand() % 2);
+            rects[i].height = 32 * (1 + rand() % 2);
+        }
+        else {
+            rects[i].x = rand() % GRID;
+            rects[i].y = rand() % GRID;
+            rects[i].width = rand() % maxsize;
+            rects[i].height = rand() % maxsize;
+        }
+        if (rects[i].x + rects[i].width > GRID)
+            rects[i].width = GRID - rects[i].x;
+        if (rects[i].y + rects[i].height > GRID)
+            rects[i].height = GRID - rects[i].y;
+        for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+            for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+                coverage[y][x] = 1;
+    }
+}
+
+static int
+compare_rects(const void *a, const void *b)
+{
+    const xRectangle *ra = a, *rb = b;
+
+    if (ra->y != rb->y)
+        return ra->y - rb->y;
+    return ra->x - rb->x;
+}
+
+static void
+region_from_rects(void)
+{
+    xRectangle rects[200];
+    RegionPtr reg;
+    int round, n;
+
+    srand(0x5eed);
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        n = 1 + rand() % 200;
+        random_rects(rects, n, 1 + rand() % 64, round & 1);
+        /* every fourth round, hand the rectangles over already sorted */
+        if ((round & 3) >= 2)
+            qsort(rects, n, sizeof(xRectangle), compare_rects);
+
+        reg = RegionFromRects(n, rects, CT_UNSORTED);
+        assert(!RegionNar(reg));
+        region_check_canonical(reg);
+        region_check_coverage(reg);
+        RegionDestroy(reg);
+    }
+}
+
+static void
+region_append(void)
+{
+    xRectangle rects[64];
+    RegionRec dst;
+    RegionPtr src;
+    Bool overlap;
+    int round, i, n;
+
+    srand(0xa99e);
+    for (round = 0; round < NUM_ROUNDS / 4; round++) {
+        n = 2 + rand() % 63;
+        random_rects(rects, n, 1 + rand() % 64, round & 1);
+
+        /* append the rectangles one region at a time, then validate */
+        RegionNull(&dst);
+        for (i = 0; i < n; i++) {
+            src = RegionFromRects(1, &rects[i], CT_UNSORTED);
+            assert(RegionAppend(&dst, src));
+            RegionDestroy(src);
+        }
+        assert(RegionValidate(&dst, &overlap));
+        region_check_canonical(&dst);
+        region_check_coverage(&dst);
+        RegionUninit(&dst);
+    }
+}
+
+static void
+region_coalesce(void)
+{
+    xRectangle rects[1000];
+    RegionPtr reg;
+    BoxPtr box;
+    int i;
+
+    /* horizontal strips of one cell per row: lots of bands to coalesce */
+    for (i = 0; i < 1000; i++) {
+        rects[i].x = (i % 10) * 20;
+        rects[i].y = i / 10;
+        rects[i].width = 10;
+        rects[i].height = 1;
+    }
+
+    reg = RegionFromRects(1000, rects, CT_UNSORTED);
+    region_check_canonical(reg);
+    assert(RegionNumRects(reg) == 10);
+    for (i = 0, box = RegionRects(reg); i < 10; i++, box++) {
+        assert(box->x1 == i * 20 && box->x2 == i * 20 + 10);
+        assert(box->y1 == 0 && box->y2 == 100);
+    }
+    RegionDestroy(reg);
+}
+
+int
+region_test(void)
+{
+    region_from_rects();
+    region_append();
+    region_coalesce();
+
+    return 0;
+}
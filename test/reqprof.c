@@ -0,0 +1,96 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the request profile counters in dix/reqprof.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "os.h"
+#include "dixstruct.h"
+#include "reqprof.h"
+
+#include "tests-common.h"
+
+static void
+reqprof_record(void)
+{
+    ClientRec client;
+    ReqProfPtr prof;
+    CARD32 total;
+    int i;
+
+    RequestProfiling = TRUE;
+    RequestProfileInit();
+    RequestProfileReset();
+
+    memset(&client, 0, sizeof(client));
+    client.index = 1;
+
+    assert(RequestProfileLookup(X_GetProperty, 0) == NULL);
+
+    client.majorOp = X_GetProperty;
+    for (i = 0; i < 10; i++) {
+        client.sequence = i + 1;
+        RequestProfileRecord(&client, GetTimeInMicros() - 1000);
+    }
+
+    prof = RequestProfileLookup(X_GetProperty, 0);
+    assert(prof);
+    assert(prof->count == 10);
+    assert(prof->total >= 10 * 1000);
+    assert(prof->max >= 1000);
+
+    /* 1000us lands in [512us, 1024us), unless the clock moved on */
+    for (i = 0, total = 0; i < REQPROF_BUCKETS; i++)
+        total += prof->hist[i];
+    assert(total == 10);
+    assert(prof->hist[10] + prof->hist[11] == 10);
+
+    /* extension requests are kept per minor opcode */
+    client.majorOp = EXTENSION_BASE + 3;
+    client.minorOp = 7;
+    RequestProfileRecord(&client, GetTimeInMicros());
+    prof = RequestProfileLookup(EXTENSION_BASE + 3, 7);
+    assert(prof && prof->count == 1);
+    assert(RequestProfileLookup(EXTENSION_BASE + 3, 6) == NULL);
+    assert(RequestProfileLookup(EXTENSION_BASE + 4, 7) == NULL);
+
+    RequestProfileReset();
+    assert(RequestProfileLookup(X_GetProperty, 0) == NULL);
+    assert(RequestProfileLookup(EXTENSION_BASE + 3, 7) == NULL);
+    RequestProfiling = FALSE;
+}
+
+int
+reqprof_test(void)
+{
+    reqprof_record();
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the per-client resource tables in dix/resource.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "dix.h"
+#include "dixstruct.h"
+#include "resource.h"
+
+#include "tests-common.h"
+
+#define NUM_STRESS_RESOURCES 50000
+
+static RESTYPE RT_TEST;
+static int deleted;
+static XID lastDeleted;
+
+static int
+test_delete(void *value, XID id)
+{
+    deleted++;
+    lastDeleted = id;
+    return Success;
+}
+
+static void
+resource_init(ClientPtr client, ClientPtr server)
+{
+    memset(server, 0, sizeof(*server));
+    serverClient = server;
+    assert(InitClientResources(serverClient));
+    RT_TEST = CreateNewResourceType(test_delete, "TEST");
+    assert(RT_TEST);
+
+    memset(client, 0, sizeof(*client));
+    client->index = 1;
+    client->clientAsMask = ((Mask) 1) << CLIENTOFFSET;
+    assert(InitClientResources(client));
+}
+
+static Bool
+lookup(XID id)
+{
+    void *value;
+
+    return dixLookupResourceByType(&value, id, RT_TEST, NULL,
+                                   DixReadAccess) == Success &&
+        value == (void *) (intptr_t) id;
+}
+
+static void
+count_resource(void *value, XID id, void *cdata)
+{
+    (*(int *) cdata)++;
+}
+
+static int adds_while_walking;
+
+static void
+add_while_walking(void *value, XID id, void *cdata)
+{
+    XID base = *(XID *) cdata;
+
+    if (adds_while_walking < 1000) {
+        XID new = base + adds_while_walking++;
+
+        assert(AddResource(new, RT_TEST, (void *) (intptr_t) new));
+    }
+}
+
+static void
+resource_hash(void)
+{
+    int bits, i;
+
+    /* bucket b of a table splits into b and b + half of the next size */
+    for (i = 0; i < 100000; i++)
+        for (bits = 1; bits < 20; bits++)
+            assert(HashResourceID(i, bits) ==
+                   (HashResourceID(i, bits + 1) & ((1 << bits) - 1)));
+    assert(HashResourceID(12345, 0) == 0);
+
+    /* an aligned run of consecutive IDs fills every bucket once */
+    for (bits = 6; bits <= 16; bits++) {
+        static char seen[1 << 16];
+        XID first = 0x50000;
+
+        memset(seen, 0, sizeof(seen));
+        for (i = 0; i < (1 << bits); i++) {
+            int b = HashResourceID(first + i, bits);
+
+            assert(!seen[b]);
+            seen[b] = 1;
+        }
+    }
+}
+
+static void
+resource_add_free(void)
+{
+    ClientRec client, server;
+    XID base, id;
+    int i, n;
+
+    resource_init(&client, &server);
+    base = client.clientAsMask;
+
+    /* grow through several rebuilds, checking lookups as we go so IDs
+     * are found both in migrated and unmigrated buckets */
+    for (i = 1; i <= 5000; i++) {
+        id = base + i;
+        assert(AddResource(id, RT_TEST, (void *) (intptr_t) id));
+        assert(lookup(id));
+        assert(lookup(base + 1 + i / 2));
+        assert(!lookup(base + i + 1));
+    }
+
+    n = 0;
+    FindClientResourcesByType(&client, RT_TEST, count_resource, &n);
+    assert(n == 5000);
+
+    /* resources added while walking must not move the buckets around */
+    adds_while_walking = 0;
+    id = base + 100000;
+    FindClientResourcesByType(&client, RT_TEST, add_while_walking, &id);
+    assert(adds_while_walking == 1000);
+    for (i = 0; i < 1000; i++)
+        assert(lookup(base + 100000 + i));
+
+    deleted = 0;
+    for (i = 1; i <= 5000; i += 2)
+        FreeResource(base + i, RT_NONE);
+    assert(deleted == 2500);
+    for (i = 1; i <= 5000; i++)
+        assert(lookup(base + i) == !(i & 1));
+
+    /* FreeResourceByType only frees one of several entries for an ID */
+    id = base + 200000;
+    assert(AddResource(id, RT_TEST, (void *) (intptr_t) id));
+    assert(AddResource(id, RT_TEST, (void *) (intptr_t) id));
+    deleted = 0;
+    FreeResourceByType(id, RT_TEST, FALSE);
+    assert(deleted == 1);
+    assert(lookup(id));
+
+    deleted = 0;
+    FreeClientResources(&client);
+    assert(deleted == 2500 + 1000 + 1);
+    assert(!lookup(base + 2));
+
+    FreeClientResources(&server);
+}
+
+/* grow a table through many rebuilds, keeping every ID reachable; the
+ * latency of AddResource on a large table is measured by the
+ * resource-create benchmark instead */
+static void
+resource_stress(void)
+{
+    ClientRec client, server;
+    XID base, id;
+    int i, n;
+
+    resource_init(&client, &server);
+    base = client.clientAsMask;
+
+    for (i = 1; i <= NUM_STRESS_RESOURCES; i++) {
+        id = base + i;
+        assert(AddResource(id, RT_TEST, (void *) (intptr_t) id));
+        if (i % 997 == 0) {
+            assert(lookup(id));
+            assert(lookup(base + 1));
+            assert(lookup(base + i / 3 + 1));
+        }
+    }
+
+    for (i = 1; i <= NUM_STRESS_RESOURCES; i++)
+        assert(lookup(base + i));
+    assert(!lookup(base + NUM_STRESS_RESOURCES + 1));
+
+    n = 0;
+    FindClientResourcesByType(&client, RT_TEST, count_resource, &n);
+    assert(n == NUM_STRESS_RESOURCES);
+
+    deleted = 0;
+    FreeClientResources(&client);
+    assert(deleted == NUM_STRESS_RESOURCES);
+    assert(!lookup(base + 1));
+
+    FreeClientResources(&server);
+}
+
+int
+resource_test(void)
+{
+    resource_hash();
+    resource_add_free();
+    resource_stress();
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Resource creation latency while a client's resource table grows.
+ *
+ * Creates a few hundred thousand GCs in batches, waiting for each batch
+ * to be processed, then changes and frees them all again the same way.
+ * Prints the time taken per request for each pass, and for creation the
+ * slowest batch too, which is where growing the table would show up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_GCS         250000
+#define BATCH           1000
+
+static xcb_connection_t *c;
+static xcb_gcontext_t gcs[NUM_GCS];
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Wait for the server to get through everything sent so far */
+static void
+sync_server(void)
+{
+    xcb_generic_error_t *error;
+
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), &error));
+    if (error) {
+        fprintf(stderr, "X error %d\n", error->error_code);
+        exit(1);
+    }
+}
+
+static uint64_t
+create_all(xcb_window_t root, uint64_t *worst)
+{
+    uint64_t start = now_usec();
+
+    *worst = 0;
+    for (int i = 0; i < NUM_GCS; i += BATCH) {
+        uint64_t batch = now_usec();
+
+        for (int j = 0; j < BATCH; j++) {
+            gcs[i + j] = xcb_generate_id(c);
+            xcb_create_gc(c, gcs[i + j], root, 0, NULL);
+        }
+        sync_server();
+
+        batch = now_usec() - batch;
+        if (batch > *worst)
+            *worst = batch;
+    }
+    return now_usec() - start;
+}
+
+static uint64_t
+change_all(void)
+{
+    uint64_t start = now_usec();
+
+    for (int i = 0; i < NUM_GCS; i += BATCH) {
+        for (int j = 0; j < BATCH; j++) {
+            uint32_t foreground = i + j;
+
+            xcb_change_gc(c, gcs[i + j], XCB_GC_FOREGROUND, &foreground);
+        }
+        sync_server();
+    }
+    return now_usec() - start;
+}
+
+static uint64_t
+free_all(void)
+{
+    uint64_t start = now_usec();
+
+    for (int i = 0; i < NUM_GCS; i += BATCH) {
+        for (int j = 0; j < BATCH; j++)
+            xcb_free_gc(c, gcs[i + j]);
+        sync_server();
+    }
+    return now_usec() - start;
+}
+
+static void
+report(const char *name, uint64_t total)
+{
+    printf("%-24s %8.2f us per request\n", name, (double)total / NUM_GCS);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_screen_t *screen;
+    uint64_t worst;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    printf("%d GCs in batches of %d\n", NUM_GCS, BATCH);
+    report("create", create_all(screen->root, &worst));
+    printf("%-24s %8.2f us per request\n", "slowest create batch",
+           (double)worst / BATCH);
+    report("change", change_all());
+    report("free", free_all());
+
+    xcb_disconnect(c);
+    return 0;
+}
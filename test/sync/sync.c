@@ -24,11 +24,16 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
+#include <poll.h>
+#include <unistd.h>
 #include <xcb/sync.h>
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
+static uint8_t sync_first_event;
+
 static const int64_t some_values[] = {
         0,
         1,
@@ -66,6 +71,103 @@ sync_value(int64_t value)
     return v;
 }
 
+/* Waits for the next event, failing the test if none comes or it's an
+ * error.
+ */
+static xcb_generic_event_t *
+wait_for_event(xcb_connection_t *c, uint8_t type)
+{
+    struct pollfd pfd = {
+        .fd = xcb_get_file_descriptor(c),
+        .events = POLLIN,
+    };
+    xcb_generic_event_t *ev;
+
+    while (!(ev = xcb_poll_for_event(c))) {
+        if (xcb_connection_has_error(c) || poll(&pfd, 1, 5000) <= 0) {
+            fprintf(stderr, "Timed out waiting for event %d\n", type);
+            exit(1);
+        }
+    }
+
+    if ((ev->response_type & 0x7f) != type) {
+        fprintf(stderr, "Expected event %d, got %d\n", type,
+                ev->response_type & 0x7f);
+        exit(1);
+    }
+
+    return ev;
+}
+
+/* Makes sure the server has nothing more to send us. */
+static void
+expect_no_events(xcb_connection_t *c, const char *test)
+{
+    xcb_generic_event_t *ev;
+
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    if ((ev = xcb_poll_for_event(c))) {
+        fprintf(stderr, "%s: unexpected event %d\n", test,
+                ev->response_type & 0x7f);
+        exit(1);
+    }
+}
+
+static xcb_sync_alarm_t
+create_alarm(xcb_connection_t *c, xcb_sync_counter_t counter,
+             uint32_t test_type, int64_t value, int64_t delta)
+{
+    xcb_sync_alarm_t alarm = xcb_generate_id(c);
+    uint32_t values[] = {
+        counter,
+        XCB_SYNC_VALUETYPE_ABSOLUTE,
+        value >> 32, value,
+        test_type,
+        delta >> 32, delta,
+    };
+
+    xcb_sync_create_alarm(c, alarm,
+                          XCB_SYNC_CA_COUNTER |
+                          XCB_SYNC_CA_VALUE_TYPE |
+                          XCB_SYNC_CA_VALUE |
+                          XCB_SYNC_CA_TEST_TYPE |
+                          XCB_SYNC_CA_DELTA,
+                          values);
+    return alarm;
+}
+
+/* Checks that the next event is an AlarmNotify from alarm, reporting
+ * the test value it fired at.
+ */
+static void
+expect_alarm(xcb_connection_t *c, const char *test,
+             xcb_sync_alarm_t alarm, int64_t alarm_value)
+{
+    xcb_sync_alarm_notify_event_t *ev = (xcb_sync_alarm_notify_event_t *)
+        wait_for_event(c, sync_first_event + XCB_SYNC_ALARM_NOTIFY);
+
+    if (ev->alarm != alarm ||
+        pack_sync_value(ev->alarm_value) != alarm_value) {
+        fprintf(stderr, "%s: expected alarm 0x%x at %lld, "
+                "got 0x%x at %lld\n", test,
+                alarm, (long long)alarm_value,
+                ev->alarm, (long long)pack_sync_value(ev->alarm_value));
+        exit(1);
+    }
+    free(ev);
+}
+
+static int64_t
+alarm_value(xcb_connection_t *c, xcb_sync_alarm_t alarm)
+{
+    xcb_sync_query_alarm_reply_t *reply =
+        xcb_sync_query_alarm_reply(c, xcb_sync_query_alarm(c, alarm), NULL);
+    int64_t value = pack_sync_value(reply->trigger.wait_value);
+
+    free(reply);
+    return value;
+}
+
 /* Initializes counters with a bunch of interesting values and makes
  * sure it comes back the same.
  */
@@ -281,6 +383,208 @@ test_change_alarm_delta(xcb_connection_t *c)
     }
 }
 
+/* Moves a counter across triggers of every test type at once, some
+ * crossed and some not, next to enough other triggers that only a few of
+ * them fire.  Triggers fire newest first, whichever test type they are.
+ */
+static void
+test_change_counter_trigger_order(xcb_connection_t *c, int others)
+{
+    xcb_sync_counter_t counter = xcb_generate_id(c);
+    xcb_sync_alarm_t alarms[8];
+
+    xcb_sync_create_counter(c, counter, sync_value(0));
+
+    /* never crossed */
+    for (int i = 0; i < others; i++)
+        create_alarm(c, counter, XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON,
+                     1000 + i, 0);
+
+    alarms[0] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_POSITIVE_TRANSITION, 5, 0);
+    alarms[1] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_NEGATIVE_COMPARISON, -5, 0);
+    alarms[2] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, 10, 0);
+    alarms[3] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_NEGATIVE_TRANSITION, -1, 0);
+    alarms[4] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, 3, 0);
+    alarms[5] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_POSITIVE_TRANSITION, 11, 0);
+    alarms[6] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_NEGATIVE_COMPARISON, -11, 0);
+    alarms[7] = create_alarm(c, counter,
+                             XCB_SYNC_TESTTYPE_POSITIVE_TRANSITION, 10, 0);
+    expect_no_events(c, "trigger order");
+
+    xcb_sync_change_counter(c, counter, sync_value(10));
+    expect_alarm(c, "trigger order", alarms[7], 10);
+    expect_alarm(c, "trigger order", alarms[4], 3);
+    expect_alarm(c, "trigger order", alarms[2], 10);
+    expect_alarm(c, "trigger order", alarms[0], 5);
+    expect_no_events(c, "trigger order");
+
+    xcb_sync_set_counter(c, counter, sync_value(-10));
+    expect_alarm(c, "trigger order", alarms[3], -1);
+    expect_alarm(c, "trigger order", alarms[1], -5);
+    expect_no_events(c, "trigger order");
+}
+
+/* Alarms with a delta move on to a new test value each time they fire,
+ * past triggers that didn't, and have to fire again from there.
+ */
+static void
+test_alarm_delta_moves_trigger(xcb_connection_t *c)
+{
+    xcb_sync_counter_t counter = xcb_generate_id(c);
+    xcb_sync_alarm_t a, b, n;
+
+    xcb_sync_create_counter(c, counter, sync_value(0));
+    a = create_alarm(c, counter, XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, 1, 10);
+    b = create_alarm(c, counter, XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, 5, 1);
+    n = create_alarm(c, counter, XCB_SYNC_TESTTYPE_NEGATIVE_TRANSITION, -1, -4);
+
+    xcb_sync_set_counter(c, counter, sync_value(1));
+    expect_alarm(c, "alarm delta", a, 1);
+    xcb_sync_set_counter(c, counter, sync_value(5));
+    expect_alarm(c, "alarm delta", b, 5);
+    expect_no_events(c, "alarm delta");
+
+    /* a is at 11 now, behind b at 6 */
+    xcb_sync_set_counter(c, counter, sync_value(11));
+    expect_alarm(c, "alarm delta", b, 6);
+    expect_alarm(c, "alarm delta", a, 11);
+    expect_no_events(c, "alarm delta");
+
+    xcb_sync_set_counter(c, counter, sync_value(-1));
+    expect_alarm(c, "alarm delta", n, -1);
+    /* n waits for -5 now, so stopping short of it doesn't fire */
+    xcb_sync_set_counter(c, counter, sync_value(-4));
+    expect_no_events(c, "alarm delta");
+    xcb_sync_set_counter(c, counter, sync_value(-5));
+    expect_alarm(c, "alarm delta", n, -5);
+    expect_no_events(c, "alarm delta");
+
+    if (alarm_value(c, a) != 21 || alarm_value(c, b) != 12 ||
+        alarm_value(c, n) != -9) {
+        fprintf(stderr, "alarm delta: alarms at %lld %lld %lld, "
+                "expected 21 12 -9\n",
+                (long long)alarm_value(c, a), (long long)alarm_value(c, b),
+                (long long)alarm_value(c, n));
+        exit(1);
+    }
+}
+
+static xcb_sync_counter_t
+system_counter(xcb_connection_t *c, const char *name)
+{
+    xcb_sync_list_system_counters_reply_t *reply =
+        xcb_sync_list_system_counters_reply(c,
+            xcb_sync_list_system_counters(c), NULL);
+    xcb_sync_systemcounter_iterator_t it =
+        xcb_sync_list_system_counters_counters_iterator(reply);
+    xcb_sync_counter_t counter = XCB_NONE;
+
+    for (; it.rem; xcb_sync_systemcounter_next(&it)) {
+        if (it.data->name_len == strlen(name) &&
+            !memcmp(xcb_sync_systemcounter_name(it.data), name,
+                    it.data->name_len)) {
+            counter = it.data->counter;
+            break;
+        }
+    }
+    free(reply);
+    return counter;
+}
+
+/* An Await with several conditions on one counter goes away as soon as
+ * the first of them fires, taking the triggers of the others with it
+ * while the counter is still running its triggers.  The server time
+ * passing the threshold crosses all of them at once, and an alarm on the
+ * same counter has to fire after them all the same.
+ */
+static void
+test_await_deletes_triggers(xcb_connection_t *c)
+{
+    xcb_connection_t *waiter = xcb_connect(NULL, NULL);
+    xcb_sync_counter_t servertime = system_counter(c, "SERVERTIME");
+    xcb_sync_waitcondition_t conditions[3];
+    xcb_sync_counter_notify_event_t *ev;
+    xcb_sync_alarm_t alarm;
+    int64_t when;
+
+    if (xcb_connection_has_error(waiter) || servertime == XCB_NONE) {
+        fprintf(stderr, "await: no second connection or SERVERTIME\n");
+        exit(1);
+    }
+
+    when = counter_value(c, xcb_sync_query_counter(c, servertime)) + 200;
+    alarm = create_alarm(c, servertime,
+                         XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, when, 0);
+    expect_no_events(c, "await");
+
+    for (int i = 0; i < ARRAY_SIZE(conditions); i++) {
+        conditions[i] = (xcb_sync_waitcondition_t) {
+            .trigger = {
+                .counter = servertime,
+                .wait_type = XCB_SYNC_VALUETYPE_ABSOLUTE,
+                .wait_value = sync_value(when),
+                .test_type = XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON,
+            },
+            .event_threshold = sync_value(0),
+        };
+    }
+    xcb_sync_await(waiter, ARRAY_SIZE(conditions), conditions);
+    xcb_flush(waiter);
+
+    for (int i = ARRAY_SIZE(conditions) - 1; i >= 0; i--) {
+        ev = (xcb_sync_counter_notify_event_t *)
+            wait_for_event(waiter, sync_first_event + XCB_SYNC_COUNTER_NOTIFY);
+        if (ev->counter != servertime || ev->count != i) {
+            fprintf(stderr, "await: CounterNotify for 0x%x count %d, "
+                    "expected 0x%x count %d\n",
+                    ev->counter, ev->count, servertime, i);
+            exit(1);
+        }
+        free(ev);
+    }
+    expect_no_events(waiter, "await");
+
+    expect_alarm(c, "await", alarm, when);
+    expect_no_events(c, "await");
+
+    xcb_disconnect(waiter);
+}
+
+/* A NegativeTransition alarm on IDLETIME at 0 fires whenever the idle
+ * time is reset.  Once it has, the counter sits right on the threshold,
+ * which still has to be bracketed for the alarm to fire again.
+ */
+static void
+test_idletime_bracket_at_threshold(xcb_connection_t *c)
+{
+    xcb_sync_counter_t idletime = system_counter(c, "IDLETIME");
+    xcb_sync_alarm_t alarm;
+
+    if (idletime == XCB_NONE) {
+        fprintf(stderr, "idletime: no IDLETIME counter\n");
+        exit(1);
+    }
+
+    alarm = create_alarm(c, idletime,
+                         XCB_SYNC_TESTTYPE_NEGATIVE_TRANSITION, 0, 0);
+
+    for (int i = 0; i < 2; i++) {
+        /* let the server see some idle time before resetting it */
+        usleep(20 * 1000);
+        expect_no_events(c, "idletime");
+        xcb_force_screen_saver(c, XCB_SCREEN_SAVER_RESET);
+        xcb_flush(c);
+        expect_alarm(c, "idletime", alarm, 0);
+    }
+}
+
 int main(int argc, char **argv)
 {
     int screen;
@@ -291,6 +595,7 @@ int main(int argc, char **argv)
         printf("No XSync present\n");
         exit(77);
     }
+    sync_first_event = ext->first_event;
 
     test_create_counter(c);
     test_set_counter(c);
@@ -298,6 +603,11 @@ int main(int argc, char **argv)
     test_change_counter_overflow(c);
     test_change_alarm_value(c);
     test_change_alarm_delta(c);
+    test_change_counter_trigger_order(c, 0);
+    test_change_counter_trigger_order(c, 100);
+    test_alarm_delta_moves_trigger(c);
+    test_await_deletes_triggers(c);
+    test_idletime_bracket_at_threshold(c);
 
     xcb_disconnect(c);
     exit(0);
@@ -0,0 +1,164 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the OsTimer wheel in os/WaitFor.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include "misc.h"
+#include "os.h"
+
+#include "tests-common.h"
+
+#define NUM_TIMERS 10000
+#define FIRE_SPREAD 20          /* ms over which the near timers expire */
+#define FAR_SPREAD (3600 * 1000)
+
+typedef struct {
+    OsTimerPtr timer;
+    CARD32 expires;
+    Bool cancelled;
+    int fired;
+} TestTimerRec;
+
+static TestTimerRec timers[NUM_TIMERS];
+static CARD32 last_expires;
+static Bool in_check;
+static int num_fired;
+
+static CARD32
+timer_callback(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    TestTimerRec *t = arg;
+
+    assert(t->timer == timer);
+    assert(!t->cancelled);
+    assert(!t->fired);
+    assert((int) (t->expires - now) <= 0);
+    /* TimerCheck() runs timers in expiry order */
+    if (in_check) {
+        assert((int) (t->expires - last_expires) >= 0);
+        last_expires = t->expires;
+    }
+    t->fired++;
+    num_fired++;
+    return 0;
+}
+
+static CARD32
+periodic_callback(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    int *count = arg;
+
+    return ++(*count) < 3 ? 1 : 0;
+}
+
+static void
+timer_periodic(void)
+{
+    OsTimerPtr timer;
+    CARD32 start;
+    int count = 0;
+
+    timer = TimerSet(NULL, 0, 1, periodic_callback, &count);
+    assert(timer);
+
+    start = GetTimeInMillis();
+    while (count < 3 && GetTimeInMillis() - start < 1000)
+        TimerCheck();
+    assert(count == 3);
+
+    /* it did not reschedule itself after the third run */
+    assert(!TimerForce(timer));
+
+    TimerSet(timer, 0, 1000, periodic_callback, &count);
+    assert(TimerForce(timer));
+    assert(count == 4);
+    TimerFree(timer);
+}
+
+static void
+timer_wheel(void)
+{
+    CARD32 now, last;
+    int i, num_near = 0;
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        timers[i].timer = TimerSet(NULL, 0, 0, NULL, NULL);
+        assert(timers[i].timer);
+    }
+
+    srand(0x7153);
+    now = last = GetTimeInMillis();
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        TestTimerRec *t = &timers[i];
+
+        /* a quarter expire shortly, the rest spread over the next hour */
+        if (i % 4 == 0)
+            t->expires = now + 1 + rand() % FIRE_SPREAD;
+        else
+            t->expires = now + 1000 + rand() % FAR_SPREAD;
+        TimerSet(t->timer, TimerAbsolute, t->expires, timer_callback, t);
+    }
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        if (i % 4 != 0) {
+            TimerCancel(timers[i].timer);
+            timers[i].cancelled = TRUE;
+        }
+        else {
+            if (timers[i].expires - now > last - now)
+                last = timers[i].expires;
+            num_near++;
+        }
+    }
+
+    last_expires = now;
+    while (num_fired < num_near) {
+        assert((int) (GetTimeInMillis() - last) < 1000);
+        in_check = TRUE;
+        TimerCheck();
+        in_check = FALSE;
+    }
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        assert(timers[i].fired == (i % 4 == 0));
+        TimerFree(timers[i].timer);
+    }
+}
+
+int
+timer_test(void)
+{
+    TimerInit();
+
+    timer_periodic();
+    timer_wheel();
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * ConfigureWindow latency over large window trees.
+ *
+ * Builds a deep tree (a long chain of nested windows) and a wide tree (a
+ * grid of top-level windows with a few children each), then moves and
+ * restacks small windows over them, timing each request with a round
+ * trip.  Prints the average and worst latency per scenario.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define DEEP_DEPTH      256
+#define WIDE_COLUMNS    32
+#define WIDE_ROWS       24
+#define WIDE_CHILDREN   4
+#define ITERATIONS      500
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+round_trip(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_window_t
+create_window(xcb_window_t parent, int x, int y, int w, int h, int bw)
+{
+    xcb_window_t win = xcb_generate_id(c);
+    uint32_t values[] = { screen->white_pixel };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, parent, x, y, w, h, bw,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL, values);
+    return win;
+}
+
+static xcb_window_t
+build_deep(void)
+{
+    xcb_window_t top, win;
+
+    top = win = create_window(screen->root, 0, 0, screen->width_in_pixels,
+                              screen->height_in_pixels, 0);
+    for (int i = 0; i < DEEP_DEPTH; i++) {
+        /* alternate between a full-size child and a slightly inset one */
+        int inset = i & 1;
+
+        win = create_window(win, inset, inset,
+                            screen->width_in_pixels - 2 * inset,
+                            screen->height_in_pixels - 2 * inset, 0);
+        xcb_map_window(c, win);
+    }
+    return top;
+}
+
+static xcb_window_t
+build_wide(void)
+{
+    int cw = screen->width_in_pixels / WIDE_COLUMNS;
+    int ch = screen->height_in_pixels / WIDE_ROWS;
+    xcb_window_t top;
+
+    top = create_window(screen->root, 0, 0, screen->width_in_pixels,
+                        screen->height_in_pixels, 0);
+    for (int row = 0; row < WIDE_ROWS; row++) {
+        for (int col = 0; col < WIDE_COLUMNS; col++) {
+            xcb_window_t cell = create_window(top, col * cw, row * ch,
+                                              cw - 2, ch - 2, 1);
+
+            for (int i = 0; i < WIDE_CHILDREN; i++)
+                create_window(cell, i * 3, i * 3, cw / 2, ch / 2, 0);
+            xcb_map_subwindows(c, cell);
+        }
+    }
+    xcb_map_subwindows(c, top);
+    return top;
+}
+
+static void
+report(const char *name, uint64_t total, uint64_t worst)
+{
+    printf("%-24s %8.1f us avg %8llu us max\n", name,
+           (double)total / ITERATIONS, (unsigned long long)worst);
+}
+
+static void
+bench_move(const char *name, xcb_window_t parent)
+{
+    int w = screen->width_in_pixels, h = screen->height_in_pixels;
+    xcb_window_t win = create_window(parent, 0, 0, w / 8, h / 8, 2);
+    uint64_t total = 0, worst = 0;
+
+    xcb_map_window(c, win);
+    round_trip();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint32_t values[] = { (i * 7) % (w - w / 8), (i * 5) % (h - h / 8) };
+        uint64_t start = now_usec(), t;
+
+        xcb_configure_window(c, win, XCB_CONFIG_WINDOW_X |
+                             XCB_CONFIG_WINDOW_Y, values);
+        round_trip();
+        t = now_usec() - start;
+        total += t;
+        if (t > worst)
+            worst = t;
+    }
+    report(name, total, worst);
+    xcb_destroy_window(c, win);
+}
+
+static void
+bench_restack(const char *name, xcb_window_t parent)
+{
+    int w = screen->width_in_pixels, h = screen->height_in_pixels;
+    xcb_window_t win[2];
+    uint64_t total = 0, worst = 0;
+
+    win[0] = create_window(parent, w / 4, h / 4, w / 4, h / 4, 2);
+    win[1] = create_window(parent, w / 3, h / 3, w / 4, h / 4, 2);
+    xcb_map_window(c, win[0]);
+    xcb_map_window(c, win[1]);
+    round_trip();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint32_t values[] = { XCB_STACK_MODE_ABOVE };
+        uint64_t start = now_usec(), t;
+
+        xcb_configure_window(c, win[i & 1], XCB_CONFIG_WINDOW_STACK_MODE,
+                             values);
+        round_trip();
+        t = now_usec() - start;
+        total += t;
+        if (t > worst)
+            worst = t;
+    }
+    report(name, total, worst);
+    xcb_destroy_window(c, win[0]);
+    xcb_destroy_window(c, win[1]);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_window_t deep, wide;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "cannot connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    deep = build_deep();
+    xcb_map_window(c, deep);
+    round_trip();
+    bench_move("deep tree move", deep);
+    bench_restack("deep tree restack", deep);
+    xcb_destroy_window(c, deep);
+
+    wide = build_wide();
+    xcb_map_window(c, wide);
+    round_trip();
+    bench_move("wide tree move", screen->root);
+    bench_restack("wide tree restack", screen->root);
+    xcb_destroy_window(c, wide);
+
+    round_trip();
+    xcb_disconnect(c);
+    return 0;
+}
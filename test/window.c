@@ -0,0 +1,216 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for pointer picking through the top-level window index in
+ * dix/window.c.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+#include "inputstr.h"
+#include "mi.h"
+
+#include "tests-common.h"
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define NUM_TOPLEVELS 500
+
+static ScreenRec screen;
+static WindowRec root;
+static WindowRec toplevels[NUM_TOPLEVELS];
+static WindowRec children[NUM_TOPLEVELS];
+
+static void
+init_window(WindowPtr pWin, WindowPtr pParent, int x, int y, int w, int h,
+            int bw)
+{
+    pWin->drawable.pScreen = &screen;
+    pWin->drawable.x = pParent->drawable.x + x + bw;
+    pWin->drawable.y = pParent->drawable.y + y + bw;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->borderWidth = bw;
+    pWin->parent = pParent;
+    RegionNull(&pWin->winSize);
+    RegionNull(&pWin->borderSize);
+
+    /* stack on top, as CreateWindow does */
+    pWin->nextSib = pParent->firstChild;
+    if (pParent->firstChild)
+        pParent->firstChild->prevSib = pWin;
+    else
+        pParent->lastChild = pWin;
+    pParent->firstChild = pWin;
+
+    SetWinSize(pWin);
+    SetBorderSize(pWin);
+}
+
+static void
+init_tree(void)
+{
+    int i;
+
+    screen.myNum = 0;
+    screen.width = SCREEN_WIDTH;
+    screen.height = SCREEN_HEIGHT;
+
+    root.drawable.pScreen = &screen;
+    root.drawable.width = SCREEN_WIDTH;
+    root.drawable.height = SCREEN_HEIGHT;
+    root.mapped = TRUE;
+    RegionInit(&root.winSize, NullBox, 1);
+    RegionReset(&root.winSize, &(BoxRec) {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT});
+    RegionInit(&root.borderSize, NullBox, 1);
+    RegionCopy(&root.borderSize, &root.winSize);
+
+    srand(1);
+    for (i = 0; i < NUM_TOPLEVELS; i++) {
+        init_window(&toplevels[i], &root,
+                    rand() % (SCREEN_WIDTH + 200) - 100,
+                    rand() % (SCREEN_HEIGHT + 200) - 100,
+                    20 + rand() % 400, 20 + rand() % 300, rand() % 3);
+        toplevels[i].mapped = rand() % 5 != 0;
+
+        init_window(&children[i], &toplevels[i], 5, 5, 10, 10, 0);
+        children[i].mapped = TRUE;
+    }
+}
+
+static WindowPtr
+pick(SpritePtr pSprite, int x, int y)
+{
+    pSprite->spriteTraceGood = 1;
+    return miSpriteTrace(pSprite, x, y);
+}
+
+/* What a plain walk of the tree finds at x/y */
+static WindowPtr
+pick_reference(int x, int y)
+{
+    WindowPtr pWin = root.firstChild, pFound = &root;
+
+    while (pWin) {
+        int bw = wBorderWidth(pWin);
+
+        if (pWin->mapped &&
+            x >= pWin->drawable.x - bw &&
+            x < pWin->drawable.x + (int) pWin->drawable.width + bw &&
+            y >= pWin->drawable.y - bw &&
+            y < pWin->drawable.y + (int) pWin->drawable.height + bw) {
+            pFound = pWin;
+            pWin = pWin->firstChild;
+        }
+        else
+            pWin = pWin->nextSib;
+    }
+    return pFound;
+}
+
+static void
+check_picks(SpritePtr pSprite)
+{
+    int i, x, y;
+
+    for (i = 0; i < 5000; i++) {
+        x = rand() % (SCREEN_WIDTH + 20) - 10;
+        y = rand() % (SCREEN_HEIGHT + 20) - 10;
+        assert(pick(pSprite, x, y) == pick_reference(x, y));
+    }
+}
+
+static void
+window_pick(SpritePtr pSprite)
+{
+    WindowPtr pWin;
+    int i, n;
+
+    /* the index is only built once the tree has been left alone */
+    check_picks(pSprite);
+    assert(TopLevelWindowsAt(&root, 100, 100, &n) != NULL);
+    assert(TopLevelWindowsAt(&root, -1, 100, &n) == NULL);
+
+    /* restacking and moving windows must be seen by the next pick */
+    for (i = 0; i < 50; i++) {
+        pWin = &toplevels[rand() % NUM_TOPLEVELS];
+        if (i & 1) {
+            MoveWindowInStack(pWin, root.firstChild);
+        }
+        else {
+            int dx = rand() % 101 - 50, dy = rand() % 101 - 50;
+
+            pWin->drawable.x += dx;
+            pWin->drawable.y += dy;
+            SetWinSize(pWin);
+            SetBorderSize(pWin);
+            pWin->firstChild->drawable.x += dx;
+            pWin->firstChild->drawable.y += dy;
+            SetWinSize(pWin->firstChild);
+            SetBorderSize(pWin->firstChild);
+        }
+        check_picks(pSprite);
+    }
+}
+
+/* A window being restacked on every pick keeps the index dropped */
+static void
+window_drag(SpritePtr pSprite)
+{
+    int i, n, x, y;
+
+    for (i = 0; i < 1000; i++) {
+        MoveWindowInStack(root.lastChild, root.firstChild);
+        x = (i * 7919u) % SCREEN_WIDTH;
+        y = (i * 104729u) % SCREEN_HEIGHT;
+        assert(pick(pSprite, x, y) == pick_reference(x, y));
+        assert(TopLevelWindowsAt(&root, x, y, &n) == NULL);
+    }
+
+    /* and it comes back once the stack is left alone */
+    check_picks(pSprite);
+    assert(TopLevelWindowsAt(&root, 100, 100, &n) != NULL);
+}
+
+int
+window_test(void)
+{
+    SpriteRec sprite = { 0 };
+    WindowPtr trace[16];
+
+    trace[0] = &root;
+    sprite.spriteTrace = trace;
+    sprite.spriteTraceSize = ARRAY_SIZE(trace);
+    sprite.spriteTraceGood = 1;
+
+    init_tree();
+    window_pick(&sprite);
+    window_drag(&sprite);
+
+    return 0;
+}